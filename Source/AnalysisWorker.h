@@ -0,0 +1,306 @@
+/*
+  ==============================================================================
+
+    AnalysisWorker.h
+    Created: 18 Oct 2026 10:46:05pm
+    Author:  User
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+#include "TripleBuffer.h"
+
+/*
+The slower features of the input audio, as worked out by an AnalysisWorker.
+Each feature has the (input) sample position it was last updated at, so whoever
+reads them can tell how fresh each one is.
+*/
+struct AnalysisFeatures
+{
+    enum Feature
+    {
+        rmsLevel = 0,     // smoothed RMS level of the input
+        zeroCrossingRate, // smoothed zero crossings per second (a rough 'brightness')
+        tempoEstimate,    // BPM, from the autocorrelation of the input's onset strength
+        tempoConfidence,  // 0.0 to 1.0, how strongly periodic the onsets are at that tempo
+        numFeatures
+    };
+
+    float values[numFeatures] = {};
+    juce::int64 updatedAtSample[numFeatures] = { -1, -1, -1, -1 }; // <- -1 if never
+};
+
+/*
+An AnalysisWorker does the analysis which doesn't need to happen in the audio callback (and
+which would be too slow for it at small buffer sizes) on its own thread.
+
+processBlock() just copies the input into a lock-free single-producer / single-consumer ring with
+pushSamples(). The worker thread wakes up every few milliseconds, analyses whatever has arrived
+in hops of 10 ms, and publishes its results through a TripleBuffer. The audio thread picks up the
+newest results once per block with updateLatest() (the StateHandler does this), and rules can
+then read each feature along with its age, to decide whether it's fresh enough to act on.
+
+If the worker falls behind and the ring fills up, new samples are dropped (and counted), so the
+audio thread never waits - the features just get older, which their ages show.
+*/
+class AnalysisWorker : private juce::Thread
+{
+public:
+
+    AnalysisWorker() : juce::Thread("Analysis Worker")
+    {
+    }
+
+    ~AnalysisWorker() override
+    {
+        stopThread(1000);
+    }
+
+    /// <summary>
+    /// Allocate everything for a sample rate and (re)start the worker thread. Call this
+    /// from prepareToPlay (i.e. never at the same time as pushSamples()).
+    /// </summary>
+    /// <param name="_sampleRate"> the sample rate of the input.</param>
+    void prepare(double _sampleRate)
+    {
+        stopThread(1000);
+
+        sampleRate = _sampleRate;
+        hopSize = juce::jmax(1, (int)(hopDuration * sampleRate));
+        frameRate = (float)(sampleRate / hopSize);
+
+        ringSize = (int)(ringDuration * sampleRate);
+        ring.assign(ringSize, 0.0f);
+        fifo.setTotalSize(ringSize);
+        fifo.reset();
+        hop.assign(hopSize, 0.0f);
+
+        numOnsetFrames = (int)(onsetHistoryDuration * frameRate);
+        onsetStrengths.assign(numOnsetFrames, 0.0f);
+        onsetIndex = 0;
+
+        samplesPushed = 0;
+        droppedSamples.store(0);
+        samplesAnalysed = 0;
+        hopsUntilTempo = hopsBetweenTempoEstimates;
+        smoothedRms = 0.0f;
+        smoothedZeroCrossings = 0.0f;
+        prevHopRms = 0.0f;
+        prevSample = 0.0f;
+        features = AnalysisFeatures();
+
+        // (the thread's stopped, so it's safe to publish from here)
+        results.getWriteBuffer() = features;
+        results.publish();
+        latest = &results.read();
+
+        startThread();
+    }
+
+    /*
+    How often the worker looks for new input, in milliseconds (the
+    ProcessingBudget slows it down when the plugin is under load).
+    */
+    void setAnalysisInterval(int _analysisIntervalMs)
+    {
+        analysisIntervalMs.store(juce::jmax(1, _analysisIntervalMs));
+    }
+
+    // =========================
+    // audio thread:
+
+    /*
+    Copy a block of input into the ring for the worker (never waits or allocates).
+    */
+    void pushSamples(const float* samples, int numSamples)
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite(numSamples, start1, size1, start2, size2);
+
+        for (int i = 0; i < size1; i++) ring[start1 + i] = samples[i];
+        for (int i = 0; i < size2; i++) ring[start2 + i] = samples[size1 + i];
+        fifo.finishedWrite(size1 + size2);
+
+        if (size1 + size2 < numSamples) droppedSamples.fetch_add(numSamples - (size1 + size2));
+        samplesPushed += numSamples;
+    }
+
+    /*
+    Pick up the newest published results (once per block, before reading any features).
+    */
+    void updateLatest()
+    {
+        latest = &results.read();
+    }
+
+    float getFeature(int feature)
+    {
+        return latest->values[feature];
+    }
+
+    /*
+    How long ago (in seconds of input) a feature was last updated - a very large number if never.
+    */
+    float getFeatureAge(int feature)
+    {
+        juce::int64 updatedAt = latest->updatedAtSample[feature];
+        if (updatedAt < 0) return 1.0e9f;
+        return (float)((double)(samplesPushed - updatedAt) / sampleRate);
+    }
+
+    int getNumDroppedSamples()
+    {
+        return droppedSamples.load();
+    }
+
+private:
+    double sampleRate = 44100.0;
+
+    // tuning
+    const float hopDuration = 0.01f;          // seconds
+    const float ringDuration = 1.0f;          // seconds
+    const float onsetHistoryDuration = 4.0f;  // seconds
+    const int hopsBetweenTempoEstimates = 50;
+    const float smoothingCoefficient = 0.97f; // <- per hop, ~0.3 s
+    const float minTempo = 60.0f;
+    const float maxTempo = 180.0f;
+    std::atomic<int> analysisIntervalMs { 5 };
+
+    // the input ring (audio thread -> worker)
+    juce::AbstractFifo fifo { 1 };
+    std::vector<float> ring;
+    int ringSize = 1;
+    juce::int64 samplesPushed = 0;          // <- audio thread's
+    std::atomic<int> droppedSamples { 0 };
+
+    // the results (worker -> audio thread)
+    TripleBuffer<AnalysisFeatures> results;
+    const AnalysisFeatures* latest = nullptr; // <- audio thread's
+
+    // worker state
+    int hopSize = 441;
+    float frameRate = 100.0f;
+    std::vector<float> hop;
+    juce::int64 samplesAnalysed = 0;
+    float smoothedRms = 0.0f;
+    float smoothedZeroCrossings = 0.0f;
+    float prevHopRms = 0.0f;
+    float prevSample = 0.0f;
+    std::vector<float> onsetStrengths; // <- circular, one per hop
+    int numOnsetFrames = 1;
+    int onsetIndex = 0;
+    int hopsUntilTempo = 0;
+    AnalysisFeatures features;
+
+    void run() override
+    {
+        while (!threadShouldExit())
+        {
+            bool analysed = false;
+            while (fifo.getNumReady() >= hopSize && !threadShouldExit())
+            {
+                readHop();
+                analyseHop();
+                analysed = true;
+            }
+
+            if (analysed)
+            {
+                results.getWriteBuffer() = features;
+                results.publish();
+            }
+
+            wait(analysisIntervalMs.load());
+        }
+    }
+
+    void readHop()
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToRead(hopSize, start1, size1, start2, size2);
+
+        for (int i = 0; i < size1; i++) hop[i] = ring[start1 + i];
+        for (int i = 0; i < size2; i++) hop[size1 + i] = ring[start2 + i];
+        fifo.finishedRead(size1 + size2);
+
+        samplesAnalysed += hopSize;
+    }
+
+    void analyseHop()
+    {
+        // where this hop ends in the input (allowing for any samples the ring had to drop)
+        juce::int64 position = samplesAnalysed + droppedSamples.load();
+
+        float sumOfSquares = 0.0f;
+        int zeroCrossings = 0;
+        for (int i = 0; i < hopSize; i++)
+        {
+            sumOfSquares += hop[i] * hop[i];
+            if ((hop[i] >= 0.0f) != (prevSample >= 0.0f)) zeroCrossings++;
+            prevSample = hop[i];
+        }
+        float rms = std::sqrt(sumOfSquares / hopSize);
+
+        smoothedRms = smoothingCoefficient * smoothedRms + (1.0f - smoothingCoefficient) * rms;
+        smoothedZeroCrossings = smoothingCoefficient * smoothedZeroCrossings + (1.0f - smoothingCoefficient) * (zeroCrossings * frameRate);
+        setFeature(AnalysisFeatures::rmsLevel, smoothedRms, position);
+        setFeature(AnalysisFeatures::zeroCrossingRate, smoothedZeroCrossings, position);
+
+        // onset strength: how much the level rose since the last hop
+        onsetStrengths[onsetIndex] = juce::jmax(0.0f, rms - prevHopRms);
+        prevHopRms = rms;
+        if (++onsetIndex >= numOnsetFrames) onsetIndex = 0;
+
+        if (--hopsUntilTempo <= 0)
+        {
+            hopsUntilTempo = hopsBetweenTempoEstimates;
+            estimateTempo(position);
+        }
+    }
+
+    /*
+    Autocorrelate the onset strengths over the lags in the tempo range, and take the strongest.
+    */
+    void estimateTempo(juce::int64 position)
+    {
+        int minLag = juce::jmax(1, (int)(60.0f * frameRate / maxTempo));
+        int maxLag = juce::jmin(numOnsetFrames - 1, (int)(60.0f * frameRate / minTempo));
+
+        float energy = 0.0f;
+        for (int i = 0; i < numOnsetFrames; i++) energy += onsetStrengths[i] * onsetStrengths[i];
+        if (energy <= 0.0f) return;
+
+        float bestCorrelation = 0.0f;
+        int bestLag = 0;
+        for (int lag = minLag; lag <= maxLag; lag++)
+        {
+            float correlation = 0.0f;
+            for (int i = lag; i < numOnsetFrames; i++)
+            {
+                // (circular buffer: both indices relative to the oldest frame)
+                int a = (onsetIndex + i) % numOnsetFrames;
+                int b = (onsetIndex + i - lag) % numOnsetFrames;
+                correlation += onsetStrengths[a] * onsetStrengths[b];
+            }
+            if (correlation > bestCorrelation)
+            {
+                bestCorrelation = correlation;
+                bestLag = lag;
+            }
+        }
+        if (bestLag == 0) return;
+
+        setFeature(AnalysisFeatures::tempoEstimate, 60.0f * frameRate / bestLag, position);
+        setFeature(AnalysisFeatures::tempoConfidence, juce::jmin(1.0f, bestCorrelation / energy), position);
+    }
+
+    void setFeature(int feature, float value, juce::int64 position)
+    {
+        features.values[feature] = value;
+        features.updatedAtSample[feature] = position;
+    }
+};
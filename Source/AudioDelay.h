@@ -0,0 +1,94 @@
+/*
+  ==============================================================================
+
+    AudioDelay.h
+    Created: 18 Oct 2026 9:10:42pm
+    Author:  User
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/*
+A plain delay line for the plugin's audio pass-through, used when the plugin reports latency
+(see the look-ahead analysis mode) so that the audio lines up with the midi it outputs.
+One circular buffer per channel, allocated in prepare() - process() never allocates.
+*/
+class AudioDelay
+{
+public:
+
+    /// <summary>
+    /// Allocate the delay buffers. Call this from prepareToPlay.
+    /// </summary>
+    /// <param name="numChannels"> the number of channels to delay.</param>
+    /// <param name="maxDelayInSamples"> the longest delay that will be asked for.</param>
+    void prepare(int numChannels, int maxDelayInSamples)
+    {
+        bufferSize = maxDelayInSamples + 1;
+        delayBuffer.setSize(numChannels, bufferSize);
+        delayBuffer.clear();
+        writeIndex = 0;
+    }
+
+    /*
+    Change the delay. The delay line is cleared, so there's no jump in the audio (just a short
+    gap of silence) - so this should only be changed now and then (the plugin's latency is fixed
+    while look-ahead analysis is on, so it only changes when the mode or sample rate does).
+    */
+    void setDelay(int _delayInSamples)
+    {
+        _delayInSamples = juce::jlimit(0, bufferSize - 1, _delayInSamples);
+        if (_delayInSamples == delayInSamples) return;
+
+        delayInSamples = _delayInSamples;
+        delayBuffer.clear();
+        writeIndex = 0;
+    }
+
+    int getDelay()
+    {
+        return delayInSamples;
+    }
+
+    /*
+    Delay a buffer of audio in place.
+    */
+    void process(juce::AudioBuffer<float>& buffer)
+    {
+        if (delayInSamples == 0) return;
+
+        int numChannels = juce::jmin(buffer.getNumChannels(), delayBuffer.getNumChannels());
+        int numSamples = buffer.getNumSamples();
+
+        for (int channel = 0; channel < numChannels; channel++)
+        {
+            float* samples = buffer.getWritePointer(channel);
+            float* delayed = delayBuffer.getWritePointer(channel);
+
+            int index = writeIndex;
+            for (int i = 0; i < numSamples; i++)
+            {
+                int readIndex = index - delayInSamples;
+                if (readIndex < 0) readIndex += bufferSize;
+
+                float in = samples[i];
+                samples[i] = delayed[readIndex];
+                delayed[index] = in;
+
+                if (++index >= bufferSize) index = 0;
+            }
+        }
+
+        writeIndex = (writeIndex + numSamples) % bufferSize;
+    }
+
+private:
+    juce::AudioBuffer<float> delayBuffer;
+    int bufferSize = 1;
+    int writeIndex = 0;
+    int delayInSamples = 0;
+};
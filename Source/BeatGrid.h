@@ -0,0 +1,176 @@
+/*
+  ==============================================================================
+
+    BeatGrid.h
+    Created: 18 Oct 2026 8:03:51pm
+    Author:  User
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "Transport.h"
+
+/*
+A BeatGrid is where the current block sits on the beat grid, worked out once per block by the
+StateHandler (straight after the Transport advances) and then read by everything that needs it -
+the EventDetector, tempo adaptation, the TransitionRules and the UI - so they all agree on the
+same grid and nothing redoes the sub-beat maths for itself.
+
+It holds:
+  - the tick position, which beat that's in, and how far into the beat it is (in ticks),
+  - for each subdivision in use (e.g. 4 sub-beats per beat), how far into the current sub-beat
+    the position is, and the sample offsets of every sub-beat boundary within the block.
+
+Subdivisions are registered up front with useSubdivision() (message thread / initialization).
+Asking for one which wasn't registered still works, it's just worked out on the spot.
+*/
+class BeatGrid
+{
+public:
+
+    static constexpr int maxSubdivision = 16;
+    static constexpr int maxBoundariesPerBlock = 64;
+
+    BeatGrid()
+    {
+        for (int d = 0; d <= maxSubdivision; d++)
+        {
+            subdivisionInUse[d] = false;
+            subBeatPhases[d] = 0;
+            numBoundaries[d] = 0;
+        }
+    }
+
+    /*
+    Have the grid work out sub-beat phases and boundaries for this subdivision every block.
+    */
+    void useSubdivision(int numSubBeats)
+    {
+        if (numSubBeats >= 1 && numSubBeats <= maxSubdivision) subdivisionInUse[numSubBeats] = true;
+    }
+
+    /// <summary>
+    /// Work out the grid for the block the Transport has just advanced over, i.e. ticks
+    /// (getPrevTickPosition(), getTickPosition()]. Called by the StateHandler once per block.
+    /// </summary>
+    /// <param name="transport"> the Transport, after its advance() for this block.</param>
+    /// <param name="numSamples"> the number of samples in the block.</param>
+    void update(Transport& transport, int numSamples)
+    {
+        tickPosition = transport.getTickPosition();
+        beat = Transport::floorDiv(tickPosition, Transport::ticksPerBeat);
+        beatPhase = (int)(tickPosition - (beat * Transport::ticksPerBeat));
+        beatPosition = transport.getBeatPosition();
+
+        juce::int64 prevTickPosition = transport.getPrevTickPosition();
+
+        for (int d = 1; d <= maxSubdivision; d++)
+        {
+            if (!subdivisionInUse[d]) continue;
+
+            // beatPhase is already small, so this doesn't need the 64-bit floorMod
+            subBeatPhases[d] = (beatPhase * d) % Transport::ticksPerBeat;
+
+            // the sub-beat boundaries (sub-beat k starts at tick ceil(k * ticksPerBeat / d)) in the block
+            numBoundaries[d] = 0;
+            juce::int64 k = Transport::floorDiv(prevTickPosition * d, Transport::ticksPerBeat) + 1;
+            while (numBoundaries[d] < maxBoundariesPerBlock)
+            {
+                juce::int64 boundaryTick = -Transport::floorDiv(-k * Transport::ticksPerBeat, d);
+                if (boundaryTick > tickPosition) break;
+
+                boundaryOffsets[d][numBoundaries[d]] = transport.getSampleOffsetOfTick(boundaryTick, numSamples);
+                numBoundaries[d] += 1;
+                k++;
+            }
+        }
+    }
+
+    // =========================
+    // some getters:
+
+    juce::int64 getTickPosition() const
+    {
+        return tickPosition;
+    }
+
+    /*
+    The (whole) beat the position is in.
+    */
+    juce::int64 getBeat() const
+    {
+        return beat;
+    }
+
+    /*
+    How far into the current beat the position is, in ticks (0 to ticksPerBeat - 1).
+    */
+    int getBeatPhase() const
+    {
+        return beatPhase;
+    }
+
+    /*
+    Beat position as a double - for display only (see Transport::getBeatPosition()).
+    */
+    double getBeatPosition() const
+    {
+        return beatPosition;
+    }
+
+    /*
+    How far into the current sub-beat the position is, as a fraction (0.0 to 1.0) of a sub-beat.
+    */
+    float getSubBeatFraction(int numSubBeats) const
+    {
+        return (float)getSubBeatPhase(numSubBeats) / Transport::ticksPerBeat;
+    }
+
+    /*
+    The distance to the nearest sub-beat (either side), as a fraction of a sub-beat (0.0 to 0.5).
+    */
+    float getDistToNearestSubBeat(int numSubBeats) const
+    {
+        float distToPrevSubBeat = getSubBeatFraction(numSubBeats);
+        return juce::jmin(distToPrevSubBeat, 1.0f - distToPrevSubBeat);
+    }
+
+    /*
+    The number of sub-beat boundaries in the block, and their sample offsets
+    (only for subdivisions registered with useSubdivision()).
+    */
+    int getNumBoundaries(int numSubBeats) const
+    {
+        return isRegistered(numSubBeats) ? numBoundaries[numSubBeats] : 0;
+    }
+
+    int getBoundaryOffset(int numSubBeats, int boundaryIndex) const
+    {
+        return boundaryOffsets[numSubBeats][boundaryIndex];
+    }
+
+private:
+    juce::int64 tickPosition = 0;
+    juce::int64 beat = 0;
+    int beatPhase = 0;
+    double beatPosition = 0.0;
+
+    bool subdivisionInUse[maxSubdivision + 1];
+    int subBeatPhases[maxSubdivision + 1]; // <- in units of 1/ticksPerBeat of a sub-beat
+    int numBoundaries[maxSubdivision + 1];
+    int boundaryOffsets[maxSubdivision + 1][maxBoundariesPerBlock];
+
+    bool isRegistered(int numSubBeats) const
+    {
+        return numSubBeats >= 1 && numSubBeats <= maxSubdivision && subdivisionInUse[numSubBeats];
+    }
+
+    int getSubBeatPhase(int numSubBeats) const
+    {
+        if (isRegistered(numSubBeats)) return subBeatPhases[numSubBeats];
+        return (int)Transport::floorMod((juce::int64)beatPhase * numSubBeats, Transport::ticksPerBeat);
+    }
+};
@@ -28,13 +28,38 @@ public:
         threshold = _threshold;
     }
 
+    /*
+    Use the events of one of the EventDetector's extra configurations (see EventDetector::addConfiguration()).
+    */
+    void setDetectorConfiguration(int _detectorConfiguration)
+    {
+        detectorConfiguration = _detectorConfiguration;
+    }
+
     bool triggered() override
     {
-        return (stateHandler->getEventDetectorPtr()->getDensity() > threshold);
+        return (stateHandler->getEventDetectorPtr()->getDensity(detectorConfiguration) > threshold);
+    }
+
+    int getNumParameters() override
+    {
+        return 2;
+    }
+
+    float getParameter(int index) override
+    {
+        return (index == 0) ? threshold : (float)detectorConfiguration;
+    }
+
+    void setParameter(int index, float value) override
+    {
+        if (index == 0) threshold = value;
+        else detectorConfiguration = (int)value;
     }
 
 private:
     float threshold;
+    int detectorConfiguration = EventDetector::mainConfiguration;
 
 };
 
@@ -55,6 +80,21 @@ public:
         return (stateHandler->getEventDetectorPtr()->getAverageVolume() > threshold);
     }
 
+    int getNumParameters() override
+    {
+        return 1;
+    }
+
+    float getParameter(int index) override
+    {
+        return threshold;
+    }
+
+    void setParameter(int index, float value) override
+    {
+        threshold = value;
+    }
+
 private:
     float threshold;
 };
@@ -90,11 +130,87 @@ public:
         else return !(stateHandler->getEventDetectorPtr()->isVolumeDecreasing(lookBack));
     }
 
+    int getNumParameters() override
+    {
+        return 2;
+    }
+
+    float getParameter(int index) override
+    {
+        return (index == 0) ? (transitionOnDecrease ? 1.0f : 0.0f) : lookBack;
+    }
+
+    void setParameter(int index, float value) override
+    {
+        if (index == 0) transitionOnDecrease = value > 0.5f;
+        else lookBack = value;
+    }
+
 private:
     bool transitionOnDecrease = true;
     float lookBack;
 };
 
+/*
+Transition if one of the AnalysisWorker's features (e.g. the tempo confidence) is above
+(or below) a threshold - but only while it's fresh: if the feature hasn't been updated
+for longer than maxAge seconds (e.g. the worker is behind), this doesn't trigger.
+*/
+class AnalysisFeatureTransition : public TransitionRule
+{
+public:
+
+    /// <summary>
+    /// Set which feature this transition looks at, and when it triggers.
+    /// </summary>
+    /// <param name="_feature"> an AnalysisFeatures::Feature.</param>
+    /// <param name="_threshold"> the value the feature has to be above (or below).</param>
+    /// <param name="_maxAge"> how old (in seconds) the feature can be and still be trusted.</param>
+    /// <param name="_transitionAbove"> trigger above the threshold (true) or below it (false).</param>
+    void setFeatureAndThreshold(int _feature, float _threshold, float _maxAge, bool _transitionAbove)
+    {
+        feature = _feature;
+        threshold = _threshold;
+        maxAge = _maxAge;
+        transitionAbove = _transitionAbove;
+    }
+
+    bool triggered() override
+    {
+        if (stateHandler->getAnalysisFeatureAge(feature) > maxAge) return false;
+
+        float value = stateHandler->getAnalysisFeature(feature);
+        return transitionAbove ? (value > threshold) : (value < threshold);
+    }
+
+    int getNumParameters() override
+    {
+        return 4;
+    }
+
+    float getParameter(int index) override
+    {
+        if (index == 0) return (float)feature;
+        if (index == 1) return threshold;
+        if (index == 2) return maxAge;
+        return transitionAbove ? 1.0f : 0.0f;
+    }
+
+    void setParameter(int index, float value) override
+    {
+        if (index == 0) feature = juce::jlimit(0, (int)AnalysisFeatures::numFeatures - 1, (int)value);
+        else if (index == 1) threshold = value;
+        else if (index == 2) maxAge = value;
+        else transitionAbove = value > 0.5f;
+    }
+
+private:
+    int feature = AnalysisFeatures::rmsLevel;
+    float threshold = 0.0f;
+    float maxAge = 0.5f;
+    bool transitionAbove = true;
+};
+
 /*
 Transition if a EventDetector detected event is within a threshold distance of a certain beat.
 */
@@ -119,6 +235,14 @@ public:
         threshold = _threshold;
     }
 
+    /*
+    Use the events of one of the EventDetector's extra configurations (see EventDetector::addConfiguration()).
+    */
+    void setDetectorConfiguration(int _detectorConfiguration)
+    {
+        detectorConfiguration = _detectorConfiguration;
+    }
+
     /*
     Returns true if beat position is within a threshold distance of desired beat,
     and either a event or release-event is occurring.
@@ -128,19 +252,45 @@ public:
         float dist = stateHandler->distToBeat(beat, subBeat, numBeats, numSubBeats);
         if (dist < threshold)
         {
-            return stateHandler->getEventDetectorPtr()->getEventOccurring() 
-                || stateHandler->getEventDetectorPtr()->getEventReleaseOccurring();
+            return stateHandler->getEventDetectorPtr()->getEventOccurring(detectorConfiguration) 
+                || stateHandler->getEventDetectorPtr()->getEventReleaseOccurring(detectorConfiguration);
         }
         else return false;
 
     }
 
+    int getNumParameters() override
+    {
+        return 6;
+    }
+
+    float getParameter(int index) override
+    {
+        if (index == 0) return (float)beat;
+        if (index == 1) return (float)subBeat;
+        if (index == 2) return (float)numBeats;
+        if (index == 3) return (float)numSubBeats;
+        if (index == 4) return threshold;
+        return (float)detectorConfiguration;
+    }
+
+    void setParameter(int index, float value) override
+    {
+        if (index == 0) beat = (int)value;
+        else if (index == 1) subBeat = (int)value;
+        else if (index == 2) numBeats = juce::jmax(1, (int)value);
+        else if (index == 3) numSubBeats = juce::jmax(1, (int)value);
+        else if (index == 4) threshold = value;
+        else detectorConfiguration = (int)value;
+    }
+
 private:
     int beat;
     int subBeat;
     int numBeats;
     int numSubBeats;
     float threshold;
+    int detectorConfiguration = EventDetector::mainConfiguration;
 };
 
 
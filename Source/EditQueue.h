@@ -0,0 +1,132 @@
+/*
+  ==============================================================================
+
+    EditQueue.h
+    Created: 18 Oct 2026 4:21:09pm
+    Author:  User
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+#include "StepPattern.h"
+
+/*
+A small plain-old-data description of one edit made in the UI. Which fields
+are used depends on the type (see the comments next to each type).
+*/
+struct EditCommand
+{
+    enum Type
+    {
+        setPattern,          // sequence, intValue = numBeats, intValue2 = numBeatDivisions (+ the staged pattern)
+        setMidiValue,        // sequence, intValue
+        setMidiVelocity,     // sequence, intValue
+        setGateLength,       // sequence, intValue (ticks)
+        setTempo,            // floatValue
+        setAdaptingTempo,    // intValue (0 or 1)
+        setAdaptationSpeed,  // floatValue
+        setAdaptationBias,   // floatValue
+        setHostSyncing,      // intValue (0 or 1)
+        setTransitionQuantum // intValue (a StateHandler::TransitionQuantum)
+    };
+
+    Type type;
+    int sequence;
+    int intValue;
+    int intValue2;
+    float floatValue;
+};
+
+/*
+A single-producer / single-consumer queue of EditCommands, from the message thread (UI) to the
+audio thread. The UI pushes commands, and the StateHandler applies them all at the start of each
+processBlock() - so nothing the audio thread reads is ever written to from another thread.
+
+A new pattern is built (parsed, sized) on the message thread into a 'staged' StepPattern which
+lives in the same slot as its command, and the audio thread then takes it with a bounded word copy.
+A slot can't be written again until the audio thread has finished reading it (that's what the
+AbstractFifo guarantees), so the staged pattern is never overwritten while it's being copied.
+
+If the queue is full, pushing fails and the edit is dropped (the UI can just send it again).
+*/
+class EditQueue
+{
+public:
+
+    static constexpr int capacity = 64;
+
+    EditQueue() : fifo(capacity), commands(capacity), stagedPatterns(capacity)
+    {
+    }
+
+    /*
+    Push a command which doesn't need a staged pattern (message thread only).
+    Returns false if the queue is full.
+    */
+    bool push(const EditCommand& command)
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite(1, start1, size1, start2, size2);
+        if (size1 == 0) return false;
+
+        commands[start1] = command;
+        fifo.finishedWrite(1);
+        return true;
+    }
+
+    /// <summary>
+    /// Push a setPattern command, building its pattern with the provided function on this
+    /// (message) thread first. Returns false if the queue is full, if the length doesn't fit in a
+    /// StepPattern, or if buildPattern returns false (e.g. the pattern text was invalid), in which case nothing is pushed.
+    /// </summary>
+    /// <param name="sequence"> which sequence the pattern is for.</param>
+    /// <param name="numBeats"> the sequence's new number of beats.</param>
+    /// <param name="numBeatDivisions"> the sequence's new number of beat divisions.</param>
+    /// <param name="buildPattern"> called with the (cleared and sized) staged StepPattern to fill in, returns false to cancel.</param>
+    template <typename BuildFunction>
+    bool pushPattern(int sequence, int numBeats, int numBeatDivisions, BuildFunction&& buildPattern)
+    {
+        if (!StepPattern::isValidLength(numBeats, numBeatDivisions)) return false;
+
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite(1, start1, size1, start2, size2);
+        if (size1 == 0) return false;
+
+        StepPattern& staged = stagedPatterns[start1];
+        staged.clear();
+        staged.setSize(numBeats * numBeatDivisions);
+        if (!buildPattern(staged)) return false; // <- nothing's been published, so the slot's just reused next time
+
+        commands[start1] = { EditCommand::setPattern, sequence, numBeats, numBeatDivisions, 0.0f };
+        fifo.finishedWrite(1);
+        return true;
+    }
+
+    /*
+    Apply every queued command, in order, with the provided function (audio thread only).
+    The function gets the command and the staged pattern in its slot.
+    */
+    template <typename ApplyFunction>
+    void applyAll(ApplyFunction&& apply)
+    {
+        int numReady = fifo.getNumReady();
+        if (numReady == 0) return;
+
+        int start1, size1, start2, size2;
+        fifo.prepareToRead(numReady, start1, size1, start2, size2);
+
+        for (int i = start1; i < start1 + size1; i++) apply(commands[i], stagedPatterns[i]);
+        for (int i = start2; i < start2 + size2; i++) apply(commands[i], stagedPatterns[i]);
+
+        fifo.finishedRead(size1 + size2);
+    }
+
+private:
+    juce::AbstractFifo fifo;
+    std::vector<EditCommand> commands;
+    std::vector<StepPattern> stagedPatterns;
+};
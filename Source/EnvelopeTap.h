@@ -0,0 +1,205 @@
+/*
+  ==============================================================================
+
+    EnvelopeTap.h
+    Created: 19 Oct 2026 12:47:13am
+    Author:  User
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+
+/*
+One column of the audio's envelope, as sent to the editor's EnvelopeView: the min and max
+sample of EnvelopeTap::samplesPerColumn samples of audio, the highest detection ratio seen
+during them, and whether an onset / release / beat fell in them.
+*/
+struct EnvelopeColumn
+{
+    enum Flags { onsetFlag = 1, releaseFlag = 2, beatFlag = 4 };
+
+    float min = 0.0f;
+    float max = 0.0f;
+    float ratio = 0.0f;
+    juce::uint8 flags = 0;
+
+    /*
+    The column covering both a and b (for building the coarser levels of the EnvelopeView's pyramid).
+    */
+    static EnvelopeColumn merge(const EnvelopeColumn& a, const EnvelopeColumn& b)
+    {
+        return { juce::jmin(a.min, b.min), juce::jmax(a.max, b.max), juce::jmax(a.ratio, b.ratio), (juce::uint8)(a.flags | b.flags) };
+    }
+};
+
+/*
+An EnvelopeTap decimates the plugin's audio output on the audio thread into EnvelopeColumns (one pass
+of min / max per block - there's nothing else to it), and hands them to the editor through a lock-free
+single-producer / single-consumer FIFO. A column can span more than one block, or a block many columns.
+
+It taps the output (i.e. after any look-ahead delay) because that's the timebase the midi goes out in,
+so the onset / release / beat markers line up with the audio they belong to. A marker can be for a
+later block than the one it's given in (its sample offset's past the end of the block) - it's kept
+until then, like a MidiOutputStage note.
+
+As with the TelemetryStream, columns are dropped (not waited for) if the FIFO's full.
+*/
+class EnvelopeTap
+{
+public:
+
+    static constexpr int samplesPerColumn = 256;
+    static constexpr int capacity = 2048; // <- about 12 s of columns at 44.1 kHz
+    static constexpr int maxPendingMarkers = 16;
+
+    EnvelopeTap() : fifo(capacity), columns(capacity)
+    {
+    }
+
+    /*
+    Empty the FIFO and start a new column (call this from prepareToPlay).
+    */
+    void prepare()
+    {
+        fifo.reset();
+        current = EnvelopeColumn();
+        samplesInColumn = 0;
+        samplePosition = 0;
+        numPendingMarkers = 0;
+    }
+
+    /// <summary>
+    /// Add a block of output (audio thread).
+    /// </summary>
+    /// <param name="samples"> the block's output samples.</param>
+    /// <param name="numSamples"> the number of samples in the block.</param>
+    /// <param name="ratio"> the EventDetector's detection ratio for the block.</param>
+    /// <param name="onsetOffset"> where an onset's notes go out (from the start of this block, can be past its end), or -1 if there wasn't one.</param>
+    /// <param name="releaseOffset"> as above, for a release.</param>
+    /// <param name="beatOffset"> as above, for the start of a beat.</param>
+    void process(const float* samples, int numSamples, float ratio, int onsetOffset, int releaseOffset, int beatOffset)
+    {
+        addMarker(onsetOffset, EnvelopeColumn::onsetFlag);
+        addMarker(releaseOffset, EnvelopeColumn::releaseFlag);
+        addMarker(beatOffset, EnvelopeColumn::beatFlag);
+
+        // the markers falling in this block, as offsets into it (they're in time order)
+        int nextMarker = 0;
+        int nextMarkerOffset = getMarkerOffset(nextMarker, numSamples);
+
+        for (int i = 0; i < numSamples; i++)
+        {
+            if (samplesInColumn == 0)
+            {
+                current.min = samples[i];
+                current.max = samples[i];
+                current.ratio = ratio;
+                current.flags = 0;
+            }
+            else
+            {
+                current.min = juce::jmin(current.min, samples[i]);
+                current.max = juce::jmax(current.max, samples[i]);
+                current.ratio = juce::jmax(current.ratio, ratio);
+            }
+
+            while (i == nextMarkerOffset)
+            {
+                current.flags |= pendingMarkers[nextMarker].flag;
+                nextMarker += 1;
+                nextMarkerOffset = getMarkerOffset(nextMarker, numSamples);
+            }
+
+            if (++samplesInColumn == samplesPerColumn)
+            {
+                pushColumn();
+                samplesInColumn = 0;
+            }
+        }
+
+        // keep the markers for later blocks
+        for (int m = nextMarker; m < numPendingMarkers; m++) pendingMarkers[m - nextMarker] = pendingMarkers[m];
+        numPendingMarkers -= nextMarker;
+        samplePosition += numSamples;
+    }
+
+    // =========================
+    // message thread:
+
+    /*
+    Move every finished column into destColumns (which is cleared first, and
+    should have capacity reserved so this doesn't allocate).
+    */
+    void readColumns(std::vector<EnvelopeColumn>& destColumns)
+    {
+        destColumns.clear();
+
+        int start1, size1, start2, size2;
+        fifo.prepareToRead(fifo.getNumReady(), start1, size1, start2, size2);
+        for (int i = 0; i < size1; i++) destColumns.push_back(columns[start1 + i]);
+        for (int i = 0; i < size2; i++) destColumns.push_back(columns[start2 + i]);
+        fifo.finishedRead(size1 + size2);
+    }
+
+private:
+    juce::AbstractFifo fifo;
+    std::vector<EnvelopeColumn> columns;
+
+    // audio thread's
+    EnvelopeColumn current;
+    int samplesInColumn = 0;
+    juce::int64 samplePosition = 0; // <- of the start of the current block
+
+    // markers still to come, in time order (positions in samples, as samplePosition)
+    struct Marker
+    {
+        juce::int64 position;
+        juce::uint8 flag;
+    };
+    Marker pendingMarkers[maxPendingMarkers];
+    int numPendingMarkers = 0;
+
+    /*
+    Insert a marker in time order (if there's room - otherwise it's just not shown).
+    */
+    void addMarker(int sampleOffset, juce::uint8 flag)
+    {
+        if (sampleOffset < 0 || numPendingMarkers >= maxPendingMarkers) return;
+
+        Marker marker = { samplePosition + sampleOffset, flag };
+        int m = numPendingMarkers;
+        while (m > 0 && pendingMarkers[m - 1].position > marker.position)
+        {
+            pendingMarkers[m] = pendingMarkers[m - 1];
+            m--;
+        }
+        pendingMarkers[m] = marker;
+        numPendingMarkers += 1;
+    }
+
+    /*
+    A pending marker's offset into the current block, or -1 if there isn't
+    one at that index in this block.
+    */
+    int getMarkerOffset(int m, int numSamples)
+    {
+        if (m >= numPendingMarkers) return -1;
+
+        juce::int64 offset = pendingMarkers[m].position - samplePosition;
+        return offset < numSamples ? (int)juce::jmax((juce::int64)0, offset) : -1;
+    }
+
+    void pushColumn()
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite(1, start1, size1, start2, size2);
+        if (size1 == 0) return;
+
+        columns[start1] = current;
+        fifo.finishedWrite(1);
+    }
+};
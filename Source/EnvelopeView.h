@@ -0,0 +1,227 @@
+/*
+  ==============================================================================
+
+    EnvelopeView.h
+    Created: 19 Oct 2026 1:05:38am
+    Author:  User
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+#include "EnvelopeTap.h"
+
+/*
+An EnvelopeView scrolls the last several seconds of audio past: the envelope (min / max) at the top,
+the EventDetector's detection ratio underneath with the detection threshold drawn over it, and a
+line at every onset (yellow), release (cyan) and beat (grey) - for tuning the detection settings.
+
+The EnvelopeColumns from the audio thread go into a min/max pyramid: level 0 is the columns as they
+arrive, and each level above merges pairs from the one below, so there's always a level with about one
+entry per pixel whatever the width. The view draws that level into a cached image, and when new entries
+arrive it just shifts the image left and draws the new ones on the right. So a frame costs a few pixel
+columns plus blitting the image, however much history is shown. Only the threshold line is drawn
+fresh in paint() (so moving the threshold doesn't mean redrawing the history).
+*/
+class EnvelopeView : public juce::Component
+{
+public:
+
+    static constexpr int historyColumns = 2048; // <- level 0's capacity (about 12 s at 44.1 kHz)
+    static constexpr int numLevels = 8;
+    static constexpr float maxRatio = 10.0f;    // <- the top of the ratio area (the threshold's maximum)
+
+    EnvelopeView()
+    {
+        setOpaque(true);
+        for (int k = 0; k < numLevels; k++) levels[k].entries.resize(historyColumns >> k);
+    }
+
+    /*
+    Add the columns read from the processor's EnvelopeTap (message thread),
+    scrolling the cached image along by however many pixels that makes.
+    */
+    void pushColumns(const std::vector<EnvelopeColumn>& columns)
+    {
+        newEntries = 0;
+        for (auto& column : columns) addToLevel(0, column);
+
+        if (newEntries > 0 && image.isValid())
+        {
+            scrollImage(newEntries);
+            repaint();
+        }
+    }
+
+    /*
+    The detection threshold to draw over the ratio (only repaints if it's changed).
+    */
+    void setThreshold(float _threshold)
+    {
+        if (_threshold == threshold) return;
+
+        threshold = _threshold;
+        repaint();
+    }
+
+    void paint(juce::Graphics& g) override
+    {
+        if (!image.isValid())
+        {
+            g.fillAll(backgroundColour);
+            return;
+        }
+
+        g.drawImageAt(image, 0, 0);
+
+        float thresholdY = ratioToY(threshold);
+        g.setColour(juce::Colours::red);
+        g.drawHorizontalLine((int)thresholdY, 0.0f, (float)getWidth());
+    }
+
+    void resized() override
+    {
+        // the level with at least one entry per pixel, so the history fills the width
+        drawLevel = 0;
+        while (drawLevel < numLevels - 1 && (historyColumns >> (drawLevel + 1)) >= getWidth()) drawLevel++;
+
+        if (getWidth() > 0 && getHeight() > 0)
+        {
+            image = juce::Image(juce::Image::RGB, getWidth(), getHeight(), true);
+            redrawImage();
+        }
+        else image = juce::Image();
+    }
+
+private:
+
+    /*
+    One level of the pyramid: a ring of entries, plus the first of a pair waiting
+    for its partner before they're merged into the level above.
+    */
+    struct Level
+    {
+        std::vector<EnvelopeColumn> entries;
+        int writeIndex = 0;
+        int numEntries = 0;
+        EnvelopeColumn pending;
+        bool hasPending = false;
+    };
+
+    Level levels[numLevels];
+    int drawLevel = 0;
+    int newEntries = 0; // <- entries added to the draw level by the current pushColumns()
+
+    juce::Image image;
+    float threshold = 3.0f;
+
+    const juce::Colour backgroundColour = juce::Colours::black;
+    const juce::Colour envelopeColour = juce::Colours::lightgreen;
+    const juce::Colour ratioColour = juce::Colours::darkorange;
+    const float envelopeAreaFraction = 0.6f; // <- of the height, the rest's for the ratio
+
+    void addToLevel(int k, const EnvelopeColumn& column)
+    {
+        Level& level = levels[k];
+        int size = (int)level.entries.size();
+
+        level.entries[level.writeIndex] = column;
+        level.writeIndex = (level.writeIndex + 1) % size;
+        level.numEntries = juce::jmin(level.numEntries + 1, size);
+        if (k == drawLevel) newEntries += 1;
+
+        if (k + 1 >= numLevels) return;
+        if (level.hasPending)
+        {
+            level.hasPending = false;
+            addToLevel(k + 1, EnvelopeColumn::merge(level.pending, column));
+        }
+        else
+        {
+            level.pending = column;
+            level.hasPending = true;
+        }
+    }
+
+    /*
+    An entry of the draw level by age (0 = the newest), or nullptr if there isn't one that old yet.
+    */
+    const EnvelopeColumn* getEntry(int age)
+    {
+        Level& level = levels[drawLevel];
+        if (age >= level.numEntries) return nullptr;
+
+        int size = (int)level.entries.size();
+        return &level.entries[(level.writeIndex - 1 - age + 2 * size) % size];
+    }
+
+    float ratioToY(float ratio)
+    {
+        float top = envelopeAreaFraction * getHeight();
+        float fraction = juce::jlimit(0.0f, 1.0f, ratio / maxRatio);
+        return getHeight() - fraction * (getHeight() - top);
+    }
+
+    /*
+    Shift the image left by numPixels and draw that many of the newest entries on the right.
+    */
+    void scrollImage(int numPixels)
+    {
+        int width = image.getWidth();
+        numPixels = juce::jmin(numPixels, width);
+        if (numPixels < width) image.moveImageSection(0, 0, numPixels, 0, width - numPixels, image.getHeight());
+
+        juce::Graphics g(image);
+        for (int x = width - numPixels; x < width; x++) drawColumn(g, x, getEntry(width - 1 - x));
+    }
+
+    void redrawImage()
+    {
+        juce::Graphics g(image);
+        int width = image.getWidth();
+        for (int x = 0; x < width; x++) drawColumn(g, x, getEntry(width - 1 - x));
+    }
+
+    void drawColumn(juce::Graphics& g, int x, const EnvelopeColumn* entry)
+    {
+        int height = image.getHeight();
+        g.setColour(backgroundColour);
+        g.fillRect(x, 0, 1, height);
+        if (entry == nullptr) return;
+
+        // markers behind everything else
+        if (entry->flags & EnvelopeColumn::beatFlag)
+        {
+            g.setColour(juce::Colours::darkgrey);
+            g.fillRect(x, 0, 1, height);
+        }
+        if (entry->flags & EnvelopeColumn::releaseFlag)
+        {
+            g.setColour(juce::Colours::cyan);
+            g.fillRect(x, 0, 1, height);
+        }
+        if (entry->flags & EnvelopeColumn::onsetFlag)
+        {
+            g.setColour(juce::Colours::yellow);
+            g.fillRect(x, 0, 1, height);
+        }
+
+        // envelope: min to max, about the middle of its area
+        float halfEnvelope = 0.5f * envelopeAreaFraction * height;
+        float top = halfEnvelope * (1.0f - juce::jlimit(-1.0f, 1.0f, entry->max));
+        float bottom = halfEnvelope * (1.0f - juce::jlimit(-1.0f, 1.0f, entry->min));
+        g.setColour(envelopeColour);
+        g.fillRect((float)x, top, 1.0f, juce::jmax(1.0f, bottom - top));
+
+        // ratio: a bar up from the bottom
+        float ratioTop = ratioToY(entry->ratio);
+        g.setColour(ratioColour);
+        g.fillRect((float)x, ratioTop, 1.0f, height - ratioTop);
+    }
+
+    //==============================================================
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(EnvelopeView)
+};
@@ -10,6 +10,9 @@
 
 #pragma once
 
+#include <algorithm>
+#include "BeatGrid.h"
+
 class EventDetector
 {
 public:
@@ -39,6 +42,56 @@ public:
         
         numSamplesBetweenEvents = (int)(eventDuration * sampleRate);
         samplesUntilEventFinish = numSamplesBetweenEvents; // <- this will count down
+
+        // (the sample rate may have changed)
+        for (int c = 0; c < numConfigurations; c++) updateConfigurationSizes(configurations[c]);
+    }
+
+    /*
+    The main configuration - the one set up by initialize() and the setters, and
+    used by the getters which don't take a configuration.
+    */
+    static constexpr int mainConfiguration = -1;
+    static constexpr int maxNumConfigurations = 8;
+
+    /// <summary>
+    /// Add another detector configuration, evaluated alongside the main one in every detectHit()
+    /// call, on the same audio history (so it costs no extra memory, and only a few operations per
+    /// block). Call this after initialize(), from the message thread / prepareToPlay.
+    /// </summary>
+    /// <param name="_windowDuration"> period of time to look back when detecting events.</param>
+    /// <param name="_edgePositionRatio"> how far into the window (0.0 to 1.0, from the end) the edge being tested is.</param>
+    /// <param name="_detectionThreshold"> the after/before ratio for an event.</param>
+    /// <param name="_releaseDetectionThreshold"> the before/after ratio for a release-event.</param>
+    /// <param name="_eventDuration"> cooldown period for when a detected event can follow a previous event.</param>
+    /// <returns> the index of the configuration (for the getters), or mainConfiguration if there's no room.</returns>
+    int addConfiguration(float _windowDuration, float _edgePositionRatio, float _detectionThreshold, float _releaseDetectionThreshold, float _eventDuration)
+    {
+        if (numConfigurations >= maxNumConfigurations) return mainConfiguration;
+
+        Configuration& configuration = configurations[numConfigurations];
+        configuration = Configuration();
+        configuration.windowDuration = _windowDuration;
+        configuration.edgePositionRatio = _edgePositionRatio;
+        configuration.detectionThreshold = _detectionThreshold;
+        configuration.releaseDetectionThreshold = _releaseDetectionThreshold;
+        configuration.eventDuration = _eventDuration;
+        updateConfigurationSizes(configuration);
+
+        return numConfigurations++;
+    }
+
+    int getNumConfigurations()
+    {
+        return numConfigurations;
+    }
+
+    /*
+    The extra configurations can be switched off to save time (they then detect nothing).
+    */
+    void setConfigurationsEnabled(bool _configurationsEnabled)
+    {
+        configurationsEnabled = _configurationsEnabled;
     }
 
 
@@ -116,9 +169,79 @@ public:
         }
     }
     
-    void setBeatPosition(float _beatPosition)
+    /*
+    The StateHandler's BeatGrid, for where events are on the beat (see distToNearestSubBeat()).
+    */
+    void setBeatGrid(const BeatGrid* _beatGrid)
     {
-        beatPosition = _beatPosition;
+        beatGrid = _beatGrid;
+    }
+
+    int getNumEventSubBeats()
+    {
+        return numEventSubBeats;
+    }
+
+    /*
+    Look-ahead mode: the detection window is centred on the point being tested, and
+    the plugin delays its audio by getLatencySamples() so that a detected event's note
+    can be placed at the actual attack (see getOnsetSamplesAgo()) rather than at the
+    end of the block the event was detected in.
+    */
+    void setLookAheadMode(bool _lookAheadMode)
+    {
+        if (_lookAheadMode == lookAheadMode) return;
+
+        lookAheadMode = _lookAheadMode;
+        if (lookAheadMode)
+        {
+            normalEdgePositionRatio = edgePositionRatio;
+            setEdgePositionRatio(0.5f);
+        }
+        else setEdgePositionRatio(normalEdgePositionRatio);
+    }
+
+    bool isLookAheadMode()
+    {
+        return lookAheadMode;
+    }
+
+    /*
+    How far behind the input an event can be detected: the length of the 'after' part of
+    the window, i.e. how much audio has to arrive after an attack before it's tested.
+    */
+    int getLatencySamples()
+    {
+        return bigBufferSize - triggerKernelEdgePosition;
+    }
+
+    /*
+    What getLatencySamples() would be in look-ahead mode with a given window duration (the 'after'
+    half of the window). With the longest window the plugin allows, this is the fixed latency it
+    reports - so the latency doesn't change while the window duration's being adjusted.
+    */
+    static int getLookAheadLatencySamples(double sampleRate, float windowDuration)
+    {
+        int windowSize = juce::jmin((int)(windowDuration * sampleRate), bigBufferSize);
+        return windowSize - (int)(0.5f * windowSize);
+    }
+
+    /*
+    For the event found by the most recent detectHit() call: how many samples before the end
+    of the latest audio buffer its attack was (used to place notes in look-ahead mode,
+    and to measure the FastOnsetDetector's latency).
+    */
+    int getOnsetSamplesAgo()
+    {
+        return onsetSamplesAgo;
+    }
+
+    /*
+    As getOnsetSamplesAgo(), for the release found by the most recent detectHit() call.
+    */
+    int getReleaseSamplesAgo()
+    {
+        return releaseSamplesAgo;
     }
     
     // ==========================================================
@@ -132,24 +255,16 @@ public:
     /// <returns> density value </returns>
     float getDensity()
     {
-        // consider a density from currentTimeBetweenEvents as an extra element of prevEventFreqEstimates
-        // ONLY IF it decreases the final density estimate -> i.e. if playing nothing, density is gradually decreased.
-        float sumStoredIntervals = 0.0f;
-        for (float interval : prevEventIntervals)
-        {
-            sumStoredIntervals += interval;
-        }
-        float sumExcludingLast = sumStoredIntervals - prevEventIntervals[numPrevEventsConsidered-1];
-        float meanStoredInterval = sumStoredIntervals / numPrevEventsConsidered;
-        
-        if (currentTimeBetweenEvents > meanStoredInterval)
-        {
-            return 1.0f / ((currentTimeBetweenEvents + sumExcludingLast) / numPrevEventsConsidered);
-        }
-        else
-        {
-            return 1.0f / meanStoredInterval;
-        }
+        return densityFromIntervals(prevEventIntervals.data(), currentTimeBetweenEvents);
+    }
+
+    /*
+    The density of the events detected by one of the configurations (see addConfiguration()).
+    */
+    float getDensity(int configuration)
+    {
+        if (configuration < 0 || configuration >= numConfigurations) return getDensity();
+        return densityFromIntervals(configurations[configuration].prevEventIntervals, configurations[configuration].currentTimeBetweenEvents);
     }
 
     /// <summary>
@@ -192,19 +307,29 @@ public:
             bigBuffer[i + bigBufferSize - numSamples] = audioBufferPointer[i];
         }
 
+        // running sums of the rectified buffer, so any window's sum is just a subtraction - shared by
+        // every configuration (and the volume estimate below) instead of each rescanning the buffer
+        absPrefixSums[0] = 0.0;
+        for (int i = 0; i < bigBufferSize; i++)
+        {
+            absPrefixSums[i + 1] = absPrefixSums[i] + fabs(bigBuffer[i]);
+        }
+
         // update some variables used to keep track of things ----------------------------------------
         currentTimeBetweenEvents += numSamples / sampleRate; // for estimating density of events
         timeUntilAddVolume -= numSamples / sampleRate; // for occassionally adding a volume to a vector (keep track of average volume and 'is decreasing') 
         if (samplesUntilEventFinish > 0) samplesUntilEventFinish -= numSamples; // cooldown period until another event can be generated
 
+        for (int c = 0; c < numConfigurations; c++)
+        {
+            configurations[c].currentTimeBetweenEvents += numSamples / sampleRate;
+            if (configurations[c].samplesUntilEventFinish > 0) configurations[c].samplesUntilEventFinish -= numSamples;
+        }
+
         // occassionally add a calculated 'average volume' to a vector (essentially a fixed length FIFO queue)
         if (timeUntilAddVolume <= 0.0f)
         {
-            float absSum = 0.0f;
-            for (int i = 0; i < bigBufferSize; i++)
-            {
-                absSum += fabs(bigBuffer[i]);
-            }
+            float absSum = sumOfAbs(0, bigBufferSize);
             
             float endVolume = averageBigBufferVolumes[averageBigBufferVolumes.size() - 1];
 
@@ -226,32 +351,34 @@ public:
         // also reset cooldown period between events
         samplesUntilEventFinish = numSamplesBetweenEvents;
 
+        for (int c = 0; c < numConfigurations; c++)
+        {
+            configurations[c].samplesUntilEventFinish = configurations[c].numSamplesBetweenEvents;
+        }
+
         // now clear buffer
         for (int i = 0; i < bigBufferSize; i++)
         {
             bigBuffer[i] = 0.0f;
         }
+        for (int i = 0; i <= bigBufferSize; i++)
+        {
+            absPrefixSums[i] = 0.0;
+        }
     }
 
 
     bool detectHit()
     {
+        detectConfigurationHits();
+        detectionRatio = 0.0f;
+
         if (samplesUntilEventFinish <= 0)
         {
             // if cooldown period completed, now try detect events: ------------------------------------
 
-            float value = 0.0f;
-            float beforeValue = 0.0f;
-            for (int i = edgeDetectionStartIndex; i < triggerKernelEdgePosition; i++)
-            {
-                beforeValue += fabs(bigBuffer[i]);
-            }
-
-            float afterValue = 0.0f;
-            for (int i = triggerKernelEdgePosition; i < bigBufferSize; i++)
-            {
-                afterValue += fabs(bigBuffer[i]);
-            }
+            float beforeValue = sumOfAbs(edgeDetectionStartIndex, triggerKernelEdgePosition);
+            float afterValue = sumOfAbs(triggerKernelEdgePosition, bigBufferSize);
 
             float prior = priorEventLikelihood();
 
@@ -260,7 +387,8 @@ public:
 
             // check ratio of after volume to before volume, multiplied by any prior knowledge of if we're on a sub-beat
             // and hence expect rhythmic events more. Also if both values are just really small, disregard this
-            if ((prior*(afterValue / beforeValue) > detectionThreshold) && ((afterValue + beforeValue) > 2.0)) 
+            detectionRatio = prior * (afterValue / beforeValue);
+            if ((detectionRatio > detectionThreshold) && ((afterValue + beforeValue) > 2.0)) 
             {
                 // EVENT DETECTED:
                 // ====================================================
@@ -272,6 +400,8 @@ public:
                 prevEventIntervals.insert(prevEventIntervals.begin(), currentTimeBetweenEvents);
                 currentTimeBetweenEvents = 0.001f;
                 
+                onsetSamplesAgo = findOnsetSamplesAgo();
+
                 eventOccurring = true;
                 eventReleaseOccurring = false;
                 return true;
@@ -288,6 +418,9 @@ public:
                 // reset cooldown until next event can  occur ---------
                 samplesUntilEventFinish = numSamplesBetweenEvents;
 
+                // (a release is a drop in level across the edge, so that's where it's placed)
+                releaseSamplesAgo = bigBufferSize - triggerKernelEdgePosition;
+
                 eventOccurring = false;
                 eventReleaseOccurring = true;
                 return false;
@@ -321,23 +454,55 @@ public:
 
     float distToNearestSubBeat()
     {
-        float subBeatPosition = fmod(beatPosition, 1.0f) * numEventSubBeats;
-        int prevSubBeat = (int)subBeatPosition;
-        float distToPrevSubBeat = subBeatPosition -  prevSubBeat;
-        float distToNextSubBeat = (prevSubBeat + 1) - subBeatPosition;
-
-        // return the closest distance
-        if (distToPrevSubBeat < distToNextSubBeat) return distToPrevSubBeat;
-        else return distToNextSubBeat;
+        if (beatGrid == nullptr) return 0.0f;
+        return beatGrid->getDistToNearestSubBeat(numEventSubBeats);
     }
 
 
 
+    /*
+    Find where the attack of a just-detected event is within the window: the first sample
+    reaching half of the peak level in the 'after' part of the window (searching from the edge,
+    so a loud sound earlier in the 'before' part can't be mistaken for it).
+    */
+    int findOnsetSamplesAgo()
+    {
+        float peak = 0.0f;
+        for (int i = triggerKernelEdgePosition; i < bigBufferSize; i++)
+        {
+            peak = juce::jmax(peak, (float)fabs(bigBuffer[i]));
+        }
+
+        for (int i = triggerKernelEdgePosition; i < bigBufferSize; i++)
+        {
+            if (fabs(bigBuffer[i]) >= 0.5f * peak) return bigBufferSize - i;
+        }
+        return bigBufferSize - triggerKernelEdgePosition;
+    }
+
+    /*
+    The (after / before, weighted by the beat prior) ratio the most recent detectHit() compared against
+    the detection threshold - 0 while an event's still finishing, when it doesn't compare at all.
+    */
+    float getDetectionRatio()
+    {
+        return detectionRatio;
+    }
+
     float getAverageVolume()
     {
         return meanVolumeEstimate;
     }
 
+    /*
+    The mean absolute level of the most recent numSamples of input (e.g. the latest block).
+    */
+    float getRecentVolume(int numSamples)
+    {
+        numSamples = juce::jlimit(1, bigBufferSize, numSamples);
+        return (float)(sumOfAbs(bigBufferSize - numSamples, bigBufferSize) / numSamples);
+    }
+
     /*
     Just return rhythmic event detection info from most recent detectHit() call.
     -> used in transition rules so that multiple things aren't repeatetly
@@ -358,6 +523,21 @@ public:
         return eventReleaseOccurring;
     }
 
+    /*
+    As above, for one of the configurations (see addConfiguration()).
+    */
+    bool getEventOccurring(int configuration)
+    {
+        if (configuration < 0 || configuration >= numConfigurations) return eventOccurring;
+        return configurations[configuration].eventOccurring;
+    }
+
+    bool getEventReleaseOccurring(int configuration)
+    {
+        if (configuration < 0 || configuration >= numConfigurations) return eventReleaseOccurring;
+        return configurations[configuration].eventReleaseOccurring;
+    }
+
 private:
     float sampleRate;
     int audioBufferSize;
@@ -373,13 +553,20 @@ private:
     float windowDuration;
     float edgePositionRatio = 0.5f;
     bool eventOccurring = false;
+    float detectionRatio = 0.0f; // <- from the most recent detectHit(), for the UI
+
+    // look-ahead mode
+    bool lookAheadMode = false;
+    float normalEdgePositionRatio = 0.5f; // <- to go back to when look-ahead mode is turned off
+    int onsetSamplesAgo = 0;
+    int releaseSamplesAgo = 0;
 
     float releaseDetectionThreshold = 3.0f;
     bool eventReleaseOccurring = false;
 
     float eventOnBeatBias;
-    float beatPosition = 0; // <- gets updated by a StateHandler
-    float numEventSubBeats; // <- the number of sub-beat division where
+    const BeatGrid* beatGrid = nullptr; // <- owned (and updated) by a StateHandler
+    int numEventSubBeats; // <- the number of sub-beat division where
                             // we expect events to be more likely
 
     int windowSizeInSamples;
@@ -388,8 +575,9 @@ private:
 
     // density of events estimation
     float maxTimeIntervalConsidered = 16.0f; // seconds
-    std::vector<float> prevEventIntervals = { 2.0f, 2.0f, 2.0f, 2.0f };
-    int numPrevEventsConsidered = prevEventIntervals.size();
+    static constexpr int numPrevEventsConsidered = 4; // <- the main detector's and every configuration's
+    static constexpr float initialEventInterval = 2.0f; // seconds
+    std::vector<float> prevEventIntervals = std::vector<float>(numPrevEventsConsidered, initialEventInterval);
     float currentTimeBetweenEvents = 0.001f; // want no chance of any divide by zero error;
 
 
@@ -397,5 +585,119 @@ private:
     float meanVolumeEstimate = 0.0f;
     float intervalBetweenAddingVolumes = 0.2f; // seconds
     float timeUntilAddVolume = intervalBetweenAddingVolumes;
-    
+
+    // running sums of fabs(bigBuffer[i]): absPrefixSums[n] is the sum of the first n samples
+    // (double, as quiet windows are small differences between large sums)
+    double absPrefixSums[bigBufferSize + 1] = {};
+
+    float sumOfAbs(int start, int end)
+    {
+        return (float)(absPrefixSums[end] - absPrefixSums[start]);
+    }
+
+    /*
+    The extra configurations: the same detection as the main one, with their own
+    window, thresholds and cooldown, and their own events and density.
+    */
+    struct Configuration
+    {
+        float windowDuration = 0.05f;
+        float edgePositionRatio = 0.5f;
+        float detectionThreshold = 3.0f;
+        float releaseDetectionThreshold = 3.0f;
+        float eventDuration = 0.2f;
+
+        int edgeDetectionStartIndex = 0;
+        int triggerKernelEdgePosition = 0;
+        int numSamplesBetweenEvents = 0;
+        int samplesUntilEventFinish = 0;
+
+        bool eventOccurring = false;
+        bool eventReleaseOccurring = false;
+        float prevEventIntervals[numPrevEventsConsidered];
+        float currentTimeBetweenEvents = 0.001f;
+
+        Configuration()
+        {
+            std::fill(prevEventIntervals, prevEventIntervals + numPrevEventsConsidered, initialEventInterval);
+        }
+    };
+
+    Configuration configurations[maxNumConfigurations];
+    int numConfigurations = 0;
+    bool configurationsEnabled = true;
+
+    void updateConfigurationSizes(Configuration& configuration)
+    {
+        int windowSize = juce::jmin((int)(configuration.windowDuration * sampleRate), bigBufferSize);
+        configuration.edgeDetectionStartIndex = bigBufferSize - windowSize;
+        configuration.triggerKernelEdgePosition = (int)((1 - configuration.edgePositionRatio) * windowSize) + configuration.edgeDetectionStartIndex;
+        configuration.numSamplesBetweenEvents = (int)(configuration.eventDuration * sampleRate);
+        configuration.samplesUntilEventFinish = configuration.numSamplesBetweenEvents;
+    }
+
+    /*
+    Run every extra configuration's detection on the current buffer (from detectHit()).
+    */
+    void detectConfigurationHits()
+    {
+        if (numConfigurations == 0) return;
+
+        float prior = priorEventLikelihood();
+
+        for (int c = 0; c < numConfigurations; c++)
+        {
+            Configuration& configuration = configurations[c];
+            configuration.eventOccurring = false;
+            configuration.eventReleaseOccurring = false;
+
+            if (!configurationsEnabled || configuration.samplesUntilEventFinish > 0) continue;
+
+            float beforeValue = juce::jmax(sumOfAbs(configuration.edgeDetectionStartIndex, configuration.triggerKernelEdgePosition), 0.000001f);
+            float afterValue = juce::jmax(sumOfAbs(configuration.triggerKernelEdgePosition, bigBufferSize), 0.000001f);
+            if ((afterValue + beforeValue) <= 2.0f) continue;
+
+            if (prior * (afterValue / beforeValue) > configuration.detectionThreshold)
+            {
+                configuration.samplesUntilEventFinish = configuration.numSamplesBetweenEvents;
+                for (int i = numPrevEventsConsidered - 1; i > 0; i--)
+                {
+                    configuration.prevEventIntervals[i] = configuration.prevEventIntervals[i - 1];
+                }
+                configuration.prevEventIntervals[0] = configuration.currentTimeBetweenEvents;
+                configuration.currentTimeBetweenEvents = 0.001f;
+                configuration.eventOccurring = true;
+            }
+            else if (prior * (beforeValue / afterValue) > configuration.releaseDetectionThreshold)
+            {
+                configuration.samplesUntilEventFinish = configuration.numSamplesBetweenEvents;
+                configuration.eventReleaseOccurring = true;
+            }
+        }
+    }
+
+    /*
+    Density from the intervals between the last numPrevEventsConsidered events: consider a density
+    from currentTime (since the last event) as an extra element of prevEventIntervals ONLY IF it
+    decreases the final density estimate -> i.e. if playing nothing, density is gradually decreased.
+    */
+    float densityFromIntervals(const float* intervals, float currentTime)
+    {
+        float sumStoredIntervals = 0.0f;
+        for (int i = 0; i < numPrevEventsConsidered; i++)
+        {
+            sumStoredIntervals += intervals[i];
+        }
+        float sumExcludingLast = sumStoredIntervals - intervals[numPrevEventsConsidered-1];
+        float meanStoredInterval = sumStoredIntervals / numPrevEventsConsidered;
+        
+        if (currentTime > meanStoredInterval)
+        {
+            return 1.0f / ((currentTime + sumExcludingLast) / numPrevEventsConsidered);
+        }
+        else
+        {
+            return 1.0f / meanStoredInterval;
+        }
+    }
 };
\ No newline at end of file
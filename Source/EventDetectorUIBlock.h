@@ -25,6 +25,7 @@ public:
     EventDetectorUIBlock(Assignment3AudioProcessor* _audioProcessor)
     {
         audioProcessor = _audioProcessor;
+        setOpaque(true);
 
         using SliderAttachment = juce::AudioProcessorValueTreeState::SliderAttachment;
         
@@ -57,6 +58,58 @@ public:
         addAndMakeVisible(eventOnBeatBiasLabel);
         eventOnBeatBiasLabel.setText("Event-on-beat bias", juce::dontSendNotification);
         eventOnBeatBiasLabel.attachToComponent(&eventOnBeatBiasSlider, true);
+
+        lowLatencyOnsetsAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(audioProcessor->parameters, "low_latency_onsets", lowLatencyOnsetsToggle);
+        addAndMakeVisible(lowLatencyOnsetsToggle);
+        addAndMakeVisible(lowLatencyOnsetsLabel);
+        lowLatencyOnsetsLabel.setText("Fast onsets", juce::dontSendNotification);
+        lowLatencyOnsetsLabel.attachToComponent(&lowLatencyOnsetsToggle, true);
+
+        addAndMakeVisible(onsetLatencyLabel);
+        addAndMakeVisible(volumeLabel);
+        addAndMakeVisible(densityLabel);
+        addAndMakeVisible(onsetCountLabel);
+    }
+
+    /*
+    Show the measured latency of the fast onsets (called by the editor's timer).
+    */
+    void updateOnsetLatency()
+    {
+        // (the labels are only changed - and repainted - when what they'd show changes)
+        int latencyTenths = juce::roundToInt(audioProcessor->getFastOnsetLatencyMs() * 10.0f);
+        if (latencyTenths == shownLatencyTenths) return;
+
+        shownLatencyTenths = latencyTenths;
+        onsetLatencyLabel.setText(juce::String(latencyTenths / 10.0f, 1) + " ms", juce::dontSendNotification);
+    }
+
+    /*
+    Show what the detector's seeing, from the latest TelemetryFrame
+    (and the onsets / releases counted since the editor was opened).
+    */
+    void updateTelemetry(float volume, float density, int numOnsets, int numReleases)
+    {
+        int volumeThousandths = juce::roundToInt(volume * 1000.0f);
+        if (volumeThousandths != shownVolumeThousandths)
+        {
+            shownVolumeThousandths = volumeThousandths;
+            volumeLabel.setText("Level " + juce::String(volumeThousandths / 1000.0f, 3), juce::dontSendNotification);
+        }
+
+        int densityHundredths = juce::roundToInt(density * 100.0f);
+        if (densityHundredths != shownDensityHundredths)
+        {
+            shownDensityHundredths = densityHundredths;
+            densityLabel.setText("Density " + juce::String(densityHundredths / 100.0f, 2), juce::dontSendNotification);
+        }
+
+        if (numOnsets != shownNumOnsets || numReleases != shownNumReleases)
+        {
+            shownNumOnsets = numOnsets;
+            shownNumReleases = numReleases;
+            onsetCountLabel.setText("Onsets " + juce::String(numOnsets) + " / releases " + juce::String(numReleases), juce::dontSendNotification);
+        }
     }
 
     /*
@@ -82,6 +135,12 @@ public:
         releaseDetectionThresholdSlider.setBounds(halfWidth, y + 70, halfWidth, 20);
         eventOnBeatBiasSlider.setBounds(halfWidth, y + 90, halfWidth, 20);
 
+        lowLatencyOnsetsToggle.setBounds(x + 90, y + 10, 20, 20);
+        onsetLatencyLabel.setBounds(x + 10, y + 30, 80, 20);
+        volumeLabel.setBounds(x + 10, y + 50, halfWidth - 20, 20);
+        densityLabel.setBounds(x + 10, y + 70, halfWidth - 20, 20);
+        onsetCountLabel.setBounds(x + 10, y + 90, halfWidth - 20, 20);
+
     }
 
 private:
@@ -106,4 +165,19 @@ private:
     juce::Slider eventOnBeatBiasSlider;
     juce::Label eventOnBeatBiasLabel;
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> eventOnBeatBiasAttachment;
+
+    juce::ToggleButton lowLatencyOnsetsToggle;
+    juce::Label lowLatencyOnsetsLabel;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> lowLatencyOnsetsAttachment;
+    juce::Label onsetLatencyLabel;
+    juce::Label volumeLabel;
+    juce::Label densityLabel;
+    juce::Label onsetCountLabel;
+
+    // what the labels are currently showing (-1 = nothing yet)
+    int shownLatencyTenths = -1;
+    int shownVolumeThousandths = -1;
+    int shownDensityHundredths = -1;
+    int shownNumOnsets = -1;
+    int shownNumReleases = -1;
 };
\ No newline at end of file
@@ -0,0 +1,226 @@
+/*
+  ==============================================================================
+
+    FastOnsetDetector.h
+    Created: 18 Oct 2026 9:52:16pm
+    Author:  User
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/*
+A FastOnsetDetector looks for attacks sample by sample, so an event's notes can go out within a
+couple of milliseconds of the attack - rather than waiting for the EventDetector's window to
+fill up after it (~25 ms with the default 50 ms window), which is clearly audible when layering.
+
+It follows a fast envelope of the input and fires when the envelope's slope over the last
+slopeDuration seconds jumps well above the slow (background) level. That's quicker but less
+reliable than the EventDetector, so every onset it fires is then waiting for confirmation: if
+the EventDetector detects the event within the confirmation window, the onset is confirmed (and
+the latency from the actual attack, as located by the EventDetector, is measured). Otherwise it's
+retracted, and the caller should cut short the notes it output for it (which the caller should
+hold on until then, so there's still something to cut).
+
+All state is a handful of floats and a small fixed ring buffer, so nothing is allocated.
+*/
+class FastOnsetDetector
+{
+public:
+
+    static constexpr int maxSlopeSamples = 512;
+
+    /*
+    Set everything up for a sample rate (call this from prepareToPlay).
+    */
+    void prepare(double _sampleRate)
+    {
+        sampleRate = _sampleRate;
+
+        slopeSamples = juce::jlimit(1, maxSlopeSamples - 1, (int)(slopeDuration * sampleRate));
+        fastRelease = std::exp(-1.0f / (float)(fastReleaseDuration * sampleRate));
+        slowCoefficient = std::exp(-1.0f / (float)(slowDuration * sampleRate));
+        cooldownSamples = (int)(cooldownDuration * sampleRate);
+
+        reset();
+    }
+
+    void reset()
+    {
+        for (int i = 0; i < maxSlopeSamples; i++) envelopeHistory[i] = 0.0f;
+        historyIndex = 0;
+        fastEnvelope = 0.0f;
+        slowEnvelope = 0.0f;
+        samplePosition = 0;
+        samplesUntilReady = 0;
+        awaitingConfirmation = false;
+        fired = false;
+        retracted = false;
+    }
+
+    /*
+    How much the envelope has to rise over slopeDuration, relative to the slow envelope, to fire.
+    */
+    void setSlopeThreshold(float _slopeThreshold)
+    {
+        slopeThreshold = _slopeThreshold;
+    }
+
+    /*
+    How long (in samples) to wait for the EventDetector to confirm an onset before retracting it.
+    */
+    void setConfirmationWindow(int _confirmationWindowSamples)
+    {
+        confirmationWindowSamples = juce::jmax(1, _confirmationWindowSamples);
+    }
+
+    /// <summary>
+    /// Run the detector over a block of input. Afterwards hasFired() / hasRetracted() say
+    /// whether an onset fired, or a previous onset was retracted, in this block.
+    /// </summary>
+    /// <param name="samples"> the input samples.</param>
+    /// <param name="numSamples"> the number of samples.</param>
+    void process(const float* samples, int numSamples)
+    {
+        fired = false;
+        retracted = false;
+
+        for (int i = 0; i < numSamples; i++)
+        {
+            float level = std::abs(samples[i]);
+
+            // instant attack / fast release for the fast envelope, a slow one-pole for the background
+            fastEnvelope = juce::jmax(level, fastEnvelope * fastRelease);
+            slowEnvelope = level + slowCoefficient * (slowEnvelope - level);
+
+            int delayedIndex = historyIndex - slopeSamples;
+            if (delayedIndex < 0) delayedIndex += maxSlopeSamples;
+            float slope = fastEnvelope - envelopeHistory[delayedIndex];
+
+            envelopeHistory[historyIndex] = fastEnvelope;
+            if (++historyIndex >= maxSlopeSamples) historyIndex = 0;
+
+            if (samplesUntilReady > 0)
+            {
+                samplesUntilReady -= 1;
+            }
+            else if (!fired && !awaitingConfirmation && fastEnvelope > minimumLevel
+                && slope > slopeThreshold * juce::jmax(slowEnvelope, minimumLevel))
+            {
+                fired = true;
+                fireOffset = i;
+                fireSamplePosition = samplePosition + i;
+                awaitingConfirmation = true;
+                samplesUntilReady = cooldownSamples;
+            }
+        }
+        samplePosition += numSamples;
+
+        // not confirmed in time?
+        if (awaitingConfirmation && !fired && samplePosition - fireSamplePosition > confirmationWindowSamples)
+        {
+            awaitingConfirmation = false;
+            retracted = true;
+        }
+    }
+
+    /*
+    Skip a block instead of process() (when the plugin's shedding work): only keeps the sample
+    count going, and drops any onset waiting for confirmation (the caller deals with its notes).
+    */
+    void skip(int numSamples)
+    {
+        fired = false;
+        retracted = false;
+        awaitingConfirmation = false;
+        samplePosition += numSamples;
+    }
+
+    /// <summary>
+    /// Called when the EventDetector detects an event (after process() for the same block).
+    /// </summary>
+    /// <param name="onsetSamplesAgo"> where the EventDetector found the attack, in samples before the end of the block.</param>
+    /// <returns> true if this confirms an onset already fired (so its notes are already out).</returns>
+    bool confirm(int onsetSamplesAgo)
+    {
+        if (!awaitingConfirmation) return false;
+        awaitingConfirmation = false;
+
+        // how long after the actual attack the onset fired
+        juce::int64 attackSamplePosition = samplePosition - onsetSamplesAgo;
+        float latencyMs = (float)(1000.0 * (double)(fireSamplePosition - attackSamplePosition) / sampleRate);
+        latencyMs = juce::jmax(0.0f, latencyMs);
+
+        measuredLatencyMs.store(hasMeasuredLatency ? (0.9f * measuredLatencyMs.load() + 0.1f * latencyMs) : latencyMs);
+        hasMeasuredLatency = true;
+        return true;
+    }
+
+    // =========================
+    // some getters:
+
+    bool hasFired()
+    {
+        return fired;
+    }
+
+    /*
+    Where in the most recent block the onset fired.
+    */
+    int getFireOffset()
+    {
+        return fireOffset;
+    }
+
+    bool hasRetracted()
+    {
+        return retracted;
+    }
+
+    /*
+    The average time between an attack and this detector firing for it, over the confirmed
+    onsets so far (safe to read from the message thread).
+    */
+    float getMeasuredLatencyMs()
+    {
+        return measuredLatencyMs.load();
+    }
+
+private:
+    double sampleRate = 44100.0;
+
+    // tuning
+    const float slopeDuration = 0.001f;        // seconds
+    const float fastReleaseDuration = 0.005f;  // seconds
+    const float slowDuration = 0.05f;          // seconds
+    const float cooldownDuration = 0.05f;      // seconds
+    const float minimumLevel = 0.01f;
+    float slopeThreshold = 2.0f;
+
+    int slopeSamples = 44;
+    float fastRelease = 0.0f;
+    float slowCoefficient = 0.0f;
+    int cooldownSamples = 0;
+    int confirmationWindowSamples = 4096;
+
+    // envelopes
+    float envelopeHistory[maxSlopeSamples];
+    int historyIndex = 0;
+    float fastEnvelope = 0.0f;
+    float slowEnvelope = 0.0f;
+
+    // onsets
+    juce::int64 samplePosition = 0;
+    int samplesUntilReady = 0;
+    bool awaitingConfirmation = false;
+    bool fired = false;
+    bool retracted = false;
+    int fireOffset = 0;
+    juce::int64 fireSamplePosition = 0;
+
+    bool hasMeasuredLatency = false;
+    std::atomic<float> measuredLatencyMs { 0.0f };
+};
@@ -0,0 +1,158 @@
+/*
+  ==============================================================================
+
+    MidiOutputStage.h
+    Created: 18 Oct 2026 6:58:03pm
+    Author:  User
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+#include <algorithm>
+#include "NoteOffQueue.h"
+
+/*
+The one place the plugin's midi output is written. During processBlock() every source
+(detected events, releases, sequence hits) just adds notes with addNote(), into a fixed
+capacity array. writeBlock() then sorts the notes by sample offset, merges duplicates
+(the same note number at the same offset - keeping the loudest velocity and longest gate),
+and writes them, along with any note-offs due from the NoteOffQueue, into a MidiBuffer
+which was reserved in prepare() - which is then merged into the host's buffer (so any midi
+coming in is passed through).
+
+A note can also be added for a later block (a sample offset past the end of the current block,
+e.g. when the plugin is delaying its audio) - it's just kept in the array until its block.
+
+Going through the notes in time order also means the NoteOffQueue sees retriggers in the
+right order, whichever source they came from.
+*/
+class MidiOutputStage
+{
+public:
+
+    /// <summary>
+    /// Allocate the note array and reserve the MidiBuffer. Call this from prepareToPlay.
+    /// Pending note-offs are kept (and output at the start of the next block), so no note is left hanging.
+    /// </summary>
+    /// <param name="_capacity"> the most notes that can be output in one block (more are dropped).</param>
+    void prepare(int _capacity)
+    {
+        capacity = _capacity;
+        notes.assign(capacity, Note());
+        numNotes = 0;
+
+        // a note-on and a note-off for each note (3 bytes each, plus JUCE's per-event header)
+        outputBuffer.clear();
+        outputBuffer.ensureSize((size_t)capacity * 2 * bytesPerEvent);
+
+        // any notes still sounding (e.g. the host re-preparing mid-playback) are ended at the start of the next block
+        noteOffQueue.flushAtNextBlock();
+    }
+
+    /// <summary>
+    /// Add a note to be output in the current block.
+    /// </summary>
+    /// <param name="sampleOffset"> where in the block the note starts (past the end of the block for a later block).</param>
+    /// <param name="midiValue"> the note number.</param>
+    /// <param name="midiVelocity"> the note-on velocity.</param>
+    /// <param name="gateInSamples"> how long the note lasts.</param>
+    /// <returns> false if the block already has as many notes as it can take.</returns>
+    bool addNote(int sampleOffset, int midiValue, juce::uint8 midiVelocity, juce::int64 gateInSamples)
+    {
+        if (numNotes >= capacity) return false;
+
+        notes[numNotes] = { sampleOffset, midiValue, midiVelocity, gateInSamples };
+        numNotes += 1;
+        return true;
+    }
+
+    /*
+    End a particular note which is still sounding from an earlier block by a given sample position
+    (e.g. to take back a note which shouldn't have been played) - see NoteOffQueue::endNoteBy().
+    */
+    void endNoteBy(int midiValue, juce::int64 noteOnSample, juce::int64 noteOffSample)
+    {
+        noteOffQueue.endNoteBy(midiValue, noteOnSample, noteOffSample);
+    }
+
+    /*
+    The sample position of an offset into the current block, to identify a note added
+    there to endNoteBy() later on.
+    */
+    juce::int64 getSamplePosition(int sampleOffset)
+    {
+        return noteOffQueue.getSamplePosition(sampleOffset);
+    }
+
+    /// <summary>
+    /// Write the block's notes (sorted and merged) and due note-offs into the plugin's MidiBuffer,
+    /// alongside the midi input already in it. Call this once per processBlock(), after all the addNote() calls.
+    /// </summary>
+    /// <param name="midiMessages"> the MidiBuffer passed to processBlock().</param>
+    /// <param name="numSamples"> the number of samples in the block.</param>
+    void writeBlock(juce::MidiBuffer& midiMessages, int numSamples)
+    {
+        std::sort(notes.begin(), notes.begin() + numNotes, [](const Note& a, const Note& b)
+            {
+                if (a.sampleOffset != b.sampleOffset) return a.sampleOffset < b.sampleOffset;
+                return a.midiValue < b.midiValue;
+            });
+
+        outputBuffer.clear();
+
+        int i = 0;
+        while (i < numNotes && notes[i].sampleOffset < numSamples)
+        {
+            // merge any duplicates (they're next to each other after sorting)
+            Note merged = notes[i];
+            int next = i + 1;
+            while (next < numNotes && notes[next].sampleOffset == merged.sampleOffset && notes[next].midiValue == merged.midiValue)
+            {
+                merged.midiVelocity = juce::jmax(merged.midiVelocity, notes[next].midiVelocity);
+                merged.gateInSamples = juce::jmax(merged.gateInSamples, notes[next].gateInSamples);
+                next++;
+            }
+
+            noteOffQueue.noteOn(outputBuffer, merged.midiValue, merged.midiVelocity, merged.sampleOffset, merged.gateInSamples);
+            i = next;
+        }
+
+        // keep any notes for later blocks (they're sorted, so they're all at the end)
+        int numLater = 0;
+        for (; i < numNotes; i++)
+        {
+            notes[numLater] = notes[i];
+            notes[numLater].sampleOffset -= numSamples;
+            numLater += 1;
+        }
+        numNotes = numLater;
+
+        noteOffQueue.endBlock(outputBuffer, numSamples);
+
+        // merge into the host's buffer, keeping its input (our own buffer stays ours, at the size
+        // reserved in prepare(), so nothing here is resized on the audio thread)
+        midiMessages.addEvents(outputBuffer, 0, -1, 0);
+    }
+
+private:
+    static constexpr int bytesPerEvent = 16;
+
+    struct Note
+    {
+        int sampleOffset;
+        int midiValue;
+        juce::uint8 midiVelocity;
+        juce::int64 gateInSamples;
+    };
+
+    int capacity = 0;
+    std::vector<Note> notes;
+    int numNotes = 0;
+
+    juce::MidiBuffer outputBuffer;
+    NoteOffQueue noteOffQueue;
+};
@@ -0,0 +1,170 @@
+/*
+  ==============================================================================
+
+    NoteOffQueue.h
+    Created: 18 Oct 2026 6:12:27pm
+    Author:  User
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/*
+Keeps track of the note-offs still to come for the notes the plugin has started, so that
+notes can have real gate lengths - which can run on past the end of the block they started
+in. There's one pending note-off per midi note number (everything is output on channel 1),
+held in a fixed array, so nothing is ever allocated however many notes are played.
+
+Times are counted in samples by the queue itself (advanced once per block by endBlock()), so
+pending note-offs still come out when the Transport is stopped, e.g. when the host stops.
+
+If a note is started again while it's still sounding (a 'retrigger'), its pending note-off is
+output first (just before the new note-on) and replaced by the new note's note-off - so a note
+is never left hanging, and never gets two note-offs.
+*/
+class NoteOffQueue
+{
+public:
+
+    static constexpr int numNotes = 128;
+
+    NoteOffQueue()
+    {
+        reset();
+    }
+
+    /*
+    Forget about any pending note-offs (e.g. in prepareToPlay - see also allNotesOff()).
+    */
+    void reset()
+    {
+        for (int n = 0; n < numNotes; n++)
+        {
+            pendingNoteOffs[n] = none;
+        }
+        blockStartSample = 0;
+        numPending = 0;
+    }
+
+    /// <summary>
+    /// Output a note-on now, and queue its note-off. If the note is already sounding its
+    /// note-off is output first.
+    /// </summary>
+    /// <param name="midiMessages"> the block's MidiBuffer.</param>
+    /// <param name="midiValue"> the note number.</param>
+    /// <param name="midiVelocity"> the note-on velocity.</param>
+    /// <param name="sampleOffset"> where in the current block the note starts.</param>
+    /// <param name="gateInSamples"> how long the note lasts (at least 1 sample).</param>
+    void noteOn(juce::MidiBuffer& midiMessages, int midiValue, juce::uint8 midiVelocity, int sampleOffset, juce::int64 gateInSamples)
+    {
+        if (midiValue < 0 || midiValue >= numNotes) return;
+
+        juce::int64 noteOnSample = blockStartSample + sampleOffset;
+
+        if (pendingNoteOffs[midiValue] != none)
+        {
+            // retrigger: end the previous note first (no later than this note-on)
+            juce::int64 noteOffSample = juce::jmin(pendingNoteOffs[midiValue], noteOnSample);
+            midiMessages.addEvent(juce::MidiMessage::noteOff(1, midiValue), (int)(noteOffSample - blockStartSample));
+            numPending -= 1;
+        }
+
+        midiMessages.addEvent(juce::MidiMessage::noteOn(1, midiValue, midiVelocity), sampleOffset);
+        pendingNoteOffs[midiValue] = noteOnSample + juce::jmax(gateInSamples, (juce::int64)1);
+        noteOnSamples[midiValue] = noteOnSample;
+        numPending += 1;
+    }
+
+    /// <summary>
+    /// Output the note-offs which fall within the current block and move on to the next block.
+    /// Call this once per processBlock(), after all the noteOn() calls.
+    /// </summary>
+    /// <param name="midiMessages"> the block's MidiBuffer.</param>
+    /// <param name="numSamples"> the number of samples in the block.</param>
+    void endBlock(juce::MidiBuffer& midiMessages, int numSamples)
+    {
+        juce::int64 blockEndSample = blockStartSample + numSamples;
+
+        for (int n = 0; n < numNotes && numPending > 0; n++)
+        {
+            if (pendingNoteOffs[n] != none && pendingNoteOffs[n] < blockEndSample)
+            {
+                midiMessages.addEvent(juce::MidiMessage::noteOff(1, n), (int)(pendingNoteOffs[n] - blockStartSample));
+                pendingNoteOffs[n] = none;
+                numPending -= 1;
+            }
+        }
+
+        blockStartSample = blockEndSample;
+    }
+
+    /// <summary>
+    /// Bring forward the note-off of one particular note - the one started at noteOnSample - to
+    /// noteOffSample, or the start of the current block if that's already passed (it's then output
+    /// by endBlock()). Does nothing if that note has already ended, or the note number's been
+    /// started again since (so it can't cut anyone else's note), or if it ends before then anyway.
+    /// </summary>
+    /// <param name="midiValue"> the note number.</param>
+    /// <param name="noteOnSample"> when the note started (see getSamplePosition()).</param>
+    /// <param name="noteOffSample"> when it should end by.</param>
+    void endNoteBy(int midiValue, juce::int64 noteOnSample, juce::int64 noteOffSample)
+    {
+        if (midiValue < 0 || midiValue >= numNotes || pendingNoteOffs[midiValue] == none) return;
+        if (noteOnSamples[midiValue] != noteOnSample) return;
+
+        noteOffSample = juce::jmax(noteOffSample, blockStartSample);
+        pendingNoteOffs[midiValue] = juce::jmin(pendingNoteOffs[midiValue], noteOffSample);
+    }
+
+    /*
+    The queue's own sample count at an offset into the current block (what endNoteBy() takes).
+    */
+    juce::int64 getSamplePosition(int sampleOffset)
+    {
+        return blockStartSample + sampleOffset;
+    }
+
+    /*
+    Output every pending note-off straight away (at the start of the current block).
+    */
+    void allNotesOff(juce::MidiBuffer& midiMessages)
+    {
+        for (int n = 0; n < numNotes && numPending > 0; n++)
+        {
+            if (pendingNoteOffs[n] != none)
+            {
+                midiMessages.addEvent(juce::MidiMessage::noteOff(1, n), 0);
+                pendingNoteOffs[n] = none;
+                numPending -= 1;
+            }
+        }
+    }
+
+    /*
+    Make every pending note-off due at the start of the next block (which endBlock() then outputs) -
+    for when there's no MidiBuffer to output them into straight away, e.g. in prepareToPlay.
+    */
+    void flushAtNextBlock()
+    {
+        for (int n = 0; n < numNotes; n++)
+        {
+            if (pendingNoteOffs[n] != none) pendingNoteOffs[n] = blockStartSample;
+        }
+    }
+
+    int getNumPending()
+    {
+        return numPending;
+    }
+
+private:
+    static constexpr juce::int64 none = -1;
+
+    juce::int64 pendingNoteOffs[numNotes]; // <- the sample each note's note-off is due at, or none
+    juce::int64 noteOnSamples[numNotes] = {}; // <- and the sample the note started at
+    juce::int64 blockStartSample = 0;
+    int numPending = 0;
+};
@@ -0,0 +1,225 @@
+/*
+  ==============================================================================
+
+    PatternParser.h
+    Created: 18 Oct 2026 5:34:40pm
+    Author:  User
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "StepPattern.h"
+
+/*
+Parses pattern text typed in the UI (or generated by scripts) straight into a StepPattern.
+It scans the raw UTF-8 bytes of the text - no temporary Strings are created, nothing is
+allocated and nothing throws. Invalid text is rejected and leaves the StepPattern untouched.
+
+Syntax:
+  x X 1-9        a hit (any digit but 0 is a hit, so older '0101' style patterns still work)
+  . - 0          a rest
+  | and spaces   ignored, just for readability, e.g. "x..x|..x."
+  [v80 p50 o-20 g240]
+                 lanes for the previous step: velocity, probability (%), offset and gate (ticks)
+  (...)          a group of steps, e.g. "(x.)"
+  *N             repeat the previous step or group N times, e.g. "(x.)*4" or ".*7"
+
+Groups can be nested (up to maxDepth deep). Steps beyond the pattern's size are ignored,
+and steps the text doesn't reach are left as rests.
+*/
+class PatternParser
+{
+public:
+
+    static constexpr int maxDepth = 8;
+    static constexpr int maxRepeat = StepPattern::maxNumSteps;
+
+    /// <summary>
+    /// Parse pattern text into a StepPattern (keeping the StepPattern's size).
+    /// </summary>
+    /// <param name="text"> the pattern text.</param>
+    /// <param name="into"> the StepPattern to fill in - only changed if the text is valid.</param>
+    /// <returns> true if the text was valid.</returns>
+    static bool parse(const juce::String& text, StepPattern& into)
+    {
+        const char* start = text.toRawUTF8();
+        const char* end = start + text.getNumBytesAsUTF8();
+
+        // check everything first, so invalid text never half-fills the pattern
+        if (!isValid(text)) return false;
+
+        into.clear();
+        int step = 0;
+        const char* pos = start;
+        parseSequence(pos, end, 0, &into, step);
+        return true;
+    }
+
+    /*
+    Just check whether some pattern text is valid, without filling in a pattern.
+    */
+    static bool isValid(const juce::String& text)
+    {
+        const char* pos = text.toRawUTF8();
+        const char* end = pos + text.getNumBytesAsUTF8();
+
+        int step = 0;
+        return parseSequence(pos, end, 0, nullptr, step) && pos == end;
+    }
+
+    /// <summary>
+    /// Read a whole non-negative number from some text (e.g. a midi note or a number of
+    /// beats typed in the UI), without allocating or throwing.
+    /// </summary>
+    /// <param name="text"> the text, which should only contain digits.</param>
+    /// <param name="result"> set to the number if the text is valid.</param>
+    /// <returns> false if the text is empty, has anything other than digits, or is too big.</returns>
+    static bool parseNumber(const juce::String& text, int& result)
+    {
+        const char* pos = text.toRawUTF8();
+        const char* end = pos + text.getNumBytesAsUTF8();
+        if (pos == end) return false;
+
+        int value = 0;
+        for (; pos < end; pos++)
+        {
+            if (*pos < '0' || *pos > '9') return false;
+            value = (value * 10) + (*pos - '0');
+            if (value > maxNumber) return false;
+        }
+        result = value;
+        return true;
+    }
+
+private:
+
+    static constexpr int maxNumber = 1000000;
+
+    /*
+    Parse steps / groups until the end of the text or a closing bracket. 'into' is nullptr
+    when only validating (in which case repeats are only checked once, not expanded).
+    */
+    static bool parseSequence(const char*& pos, const char* end, int depth, StepPattern* into, int& step)
+    {
+        while (pos < end && *pos != ')')
+        {
+            char c = *pos;
+            if (c == ' ' || c == '|')
+            {
+                pos++;
+                continue;
+            }
+
+            const char* atomStart = pos;
+            if (!parseAtom(pos, end, depth, into, step)) return false;
+
+            if (pos < end && *pos == '*')
+            {
+                pos++;
+                int repeats = 0;
+                if (!readInt(pos, end, repeats) || repeats < 1 || repeats > maxRepeat) return false;
+
+                // re-run the atom for the rest of the repeats (only worth doing while there's room left,
+                // and while it adds steps - an empty group, e.g. "(()*1024)*1024", would otherwise
+                // be re-run for nothing repeats^depth times)
+                const char* afterRepeat = pos;
+                for (int r = 1; r < repeats && into != nullptr && step < into->getSize(); r++)
+                {
+                    const char* again = atomStart;
+                    int stepBefore = step;
+                    parseAtom(again, end, depth, into, step);
+                    if (step == stepBefore) break;
+                }
+                pos = afterRepeat;
+            }
+        }
+        return true;
+    }
+
+    /*
+    Parse a single step (with any [lanes] after it), or a bracketed group.
+    */
+    static bool parseAtom(const char*& pos, const char* end, int depth, StepPattern* into, int& step)
+    {
+        char c = *pos;
+
+        if (c == '(')
+        {
+            if (depth + 1 > maxDepth) return false;
+            pos++;
+            if (!parseSequence(pos, end, depth + 1, into, step)) return false;
+            if (pos >= end || *pos != ')') return false;
+            pos++;
+            return true;
+        }
+
+        bool hit;
+        if (c == 'x' || c == 'X' || (c >= '1' && c <= '9')) hit = true;
+        else if (c == '.' || c == '-' || c == '0') hit = false;
+        else return false;
+
+        if (into != nullptr) into->setStep(step, hit);
+        step++;
+        pos++;
+
+        if (pos < end && *pos == '[')
+        {
+            pos++;
+            if (!parseLanes(pos, end, into, step - 1)) return false;
+        }
+        return true;
+    }
+
+    /*
+    Parse the inside of a [v80 p50 o-20 g240] lanes block, up to and including the ']'.
+    */
+    static bool parseLanes(const char*& pos, const char* end, StepPattern* into, int step)
+    {
+        while (pos < end && *pos != ']')
+        {
+            char lane = *pos++;
+            if (lane == ' ') continue;
+            if (lane != 'v' && lane != 'p' && lane != 'o' && lane != 'g') return false;
+
+            int sign = 1;
+            if (pos < end && *pos == '-' && lane == 'o')
+            {
+                sign = -1;
+                pos++;
+            }
+            int value = 0;
+            if (!readInt(pos, end, value)) return false;
+
+            if (into != nullptr)
+            {
+                if (lane == 'v') into->setStepVelocity(step, value);
+                else if (lane == 'p') into->setStepProbability(step, value);
+                else if (lane == 'o') into->setStepOffset(step, sign * value);
+                else into->setStepGate(step, value);
+            }
+        }
+
+        if (pos >= end) return false; // <- no closing bracket
+        pos++;
+        return true;
+    }
+
+    /*
+    Read digits into a number (at least one digit, and not too big).
+    */
+    static bool readInt(const char*& pos, const char* end, int& value)
+    {
+        const char* start = pos;
+        value = 0;
+        while (pos < end && *pos >= '0' && *pos <= '9')
+        {
+            value = (value * 10) + (*pos - '0');
+            if (value > maxNumber) return false;
+            pos++;
+        }
+        return pos != start;
+    }
+};
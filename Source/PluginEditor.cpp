@@ -20,55 +20,136 @@ Assignment3AudioProcessorEditor::Assignment3AudioProcessorEditor (Assignment3Aud
     addAndMakeVisible(*eventDetectorBlock);
     tempoBlock = std::make_unique<TempoUIBlock>(&audioProcessor);
     addAndMakeVisible(*tempoBlock);
-
-    // add all the sequence blocks:
-
-    sequence1Block = std::make_unique<SequenceUIBlock>(&audioProcessor, 0);
-    addAndMakeVisible(*sequence1Block);
-    sequence2Block = std::make_unique<SequenceUIBlock>(&audioProcessor, 1);
-    addAndMakeVisible(*sequence2Block);   
-    sequence3Block = std::make_unique<SequenceUIBlock>(&audioProcessor, 2);
-    addAndMakeVisible(*sequence3Block);
-    sequence4Block = std::make_unique<SequenceUIBlock>(&audioProcessor, 3);
-    addAndMakeVisible(*sequence4Block);
-    sequence5Block = std::make_unique<SequenceUIBlock>(&audioProcessor, 4);
-    addAndMakeVisible(*sequence5Block);
-    sequence6Block = std::make_unique<SequenceUIBlock>(&audioProcessor, 5);
-    addAndMakeVisible(*sequence6Block);
-    sequence7Block = std::make_unique<SequenceUIBlock>(&audioProcessor, 6);
-    addAndMakeVisible(*sequence7Block);
-    sequence8Block = std::make_unique<SequenceUIBlock>(&audioProcessor, 7);
-    addAndMakeVisible(*sequence8Block);
-
-    // start a timer for updating the colours and tempo slider when adapting tempo.
-    Timer::startTimerHz(5);
+    envelopeView = std::make_unique<EnvelopeView>();
+    addAndMakeVisible(*envelopeView);
+    envelopeColumns.reserve(EnvelopeTap::capacity);
+
+    // and the list of sequences in use:
+
+    sequenceList.setModel(this);
+    sequenceList.setRowHeight(sequenceRowHeight);
+    sequenceList.setColour(juce::ListBox::backgroundColourId, juce::Colours::black);
+    addAndMakeVisible(sequenceList);
+    numStatesLoaded = audioProcessor.getNumStatesLoaded();
+    updateSequenceRows();
+
+    // start a timer for updating the colours, tempo slider and telemetry readouts. Every
+    // block only repaints when what it shows has changed, so this can run at display rate.
+    telemetryFrames.reserve(TelemetryStream::capacity);
+    audioProcessor.readTelemetry(telemetryFrames); // <- throw away anything that piled up while the editor was closed
+    audioProcessor.readEnvelope(envelopeColumns);  // <- (likewise, or it'd be drawn as if it led straight up to now)
+    Timer::startTimerHz(60);
 
     setResizable(true, false);
     setResizeLimits(100, 100, 1000, 1000);
 
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
-    setSize (650, 500);
+    setSize (650, 600);
 }
 
 Assignment3AudioProcessorEditor::~Assignment3AudioProcessorEditor()
 {
+    sequenceList.setModel(nullptr);
+}
+
+void Assignment3AudioProcessorEditor::updateSequenceRows()
+{
+    sequenceRows.clear();
+    for (int i = 0; i < audioProcessor.stateHandler.getNumSequences(); i++)
+    {
+        if (audioProcessor.stateHandler.isSequenceInUse(i)) sequenceRows.push_back(i);
+    }
+
+    sequenceList.updateContent();
+    for (int row = 0; row < (int)sequenceRows.size(); row++)
+    {
+        // (a block kept for the same row and slot would still be showing what the slot held before)
+        if (auto* sequenceBlock = dynamic_cast<SequenceUIBlock*>(sequenceList.getComponentForRowNumber(row)))
+        {
+            sequenceBlock->setSequenceIndex(sequenceRows[row]);
+        }
+    }
+}
+
+int Assignment3AudioProcessorEditor::getNumRows()
+{
+    return (int)sequenceRows.size();
+}
+
+void Assignment3AudioProcessorEditor::paintListBoxItem(int rowNumber, juce::Graphics& g, int width, int height, bool rowIsSelected)
+{
+    // (every row is a SequenceUIBlock, which paints itself)
 }
 
 /*
-Every time this timer function callback happens we update the colours and tempo slider.
+Give the ListBox a SequenceUIBlock for a row coming on screen - re-pointing one it's finished
+with where there is one, and only making a new one when there isn't.
+*/
+juce::Component* Assignment3AudioProcessorEditor::refreshComponentForRow(int rowNumber, bool isRowSelected, juce::Component* existingComponentToUpdate)
+{
+    auto* sequenceBlock = dynamic_cast<SequenceUIBlock*>(existingComponentToUpdate);
+
+    if (rowNumber < 0 || rowNumber >= (int)sequenceRows.size())
+    {
+        delete existingComponentToUpdate;
+        return nullptr;
+    }
+
+    if (sequenceBlock == nullptr)
+    {
+        delete existingComponentToUpdate;
+        return new SequenceUIBlock(&audioProcessor, sequenceRows[rowNumber]);
+    }
+
+    if (sequenceBlock->getSequenceIndex() != sequenceRows[rowNumber]) sequenceBlock->setSequenceIndex(sequenceRows[rowNumber]);
+    return sequenceBlock;
+}
+
+/*
+Every time this timer function callback happens we update the colours, tempo slider and readouts
+from the latest telemetry (each block works out for itself whether anything needs repainting).
 */
 void Assignment3AudioProcessorEditor::timerCallback()
 {
-    tempoBlock->updateTempo();
-    sequence1Block->updateColour();
-    sequence2Block->updateColour();
-    sequence3Block->updateColour();
-    sequence4Block->updateColour();
-    sequence5Block->updateColour();
-    sequence6Block->updateColour();
-    sequence7Block->updateColour();
-    sequence8Block->updateColour();
+    if (audioProcessor.getNumStatesLoaded() != numStatesLoaded)
+    {
+        numStatesLoaded = audioProcessor.getNumStatesLoaded();
+        updateSequenceRows();
+    }
+
+    // everything the audio thread published since the last callback
+    audioProcessor.readTelemetry(telemetryFrames);
+    for (auto& frame : telemetryFrames)
+    {
+        if (frame.onset) numOnsetsSeen += 1;
+        if (frame.release) numReleasesSeen += 1;
+    }
+    if (!telemetryFrames.empty())
+    {
+        latestTelemetry = telemetryFrames.back();
+        tempoBlock->updateTempo(latestTelemetry.tempo);
+    }
+
+    audioProcessor.readEnvelope(envelopeColumns);
+    envelopeView->pushColumns(envelopeColumns);
+    envelopeView->setThreshold(audioProcessor.parameters.getRawParameterValue("detection_threshold")->load());
+
+    eventDetectorBlock->updateOnsetLatency();
+    eventDetectorBlock->updateTelemetry(latestTelemetry.volume, latestTelemetry.density, numOnsetsSeen, numReleasesSeen);
+
+    // only the rows on screen have a block to update
+    int firstRow = juce::jmax(0, sequenceList.getRowContainingPosition(0, 0));
+    int lastRow = juce::jmin((int)sequenceRows.size() - 1, firstRow + sequenceList.getNumRowsOnScreen());
+    for (int row = firstRow; row <= lastRow; row++)
+    {
+        auto* sequenceBlock = dynamic_cast<SequenceUIBlock*>(sequenceList.getComponentForRowNumber(row));
+        if (sequenceBlock == nullptr) continue;
+
+        int index = sequenceBlock->getSequenceIndex();
+        if (index < latestTelemetry.numSequences) sequenceBlock->updateColour((StateHandler::State)latestTelemetry.sequenceStates[index]);
+        sequenceBlock->updatePlayhead(latestTelemetry.beatPosition);
+    }
 }
 
 //==============================================================================
@@ -86,22 +167,12 @@ void Assignment3AudioProcessorEditor::resized()
     // This is generally where you'll want to lay out the positions of any
     // subcomponents in your editor..
 
-    int sequenceBlockWidth = (int)(getWidth() / 2) - 10;
-    int sequenceBlockHeight = 50;
-
-
     eventDetectorBlock->setBounds(0, 0, getWidth(), 120);
-    tempoBlock->setBounds(0, 130, getWidth(), 80);
-
-    int startY = 220;
+    tempoBlock->setBounds(0, 130, getWidth(), 100);
+    envelopeView->setBounds(0, 240, getWidth(), 100);
 
-    sequence1Block->setBounds(0, startY,                                  sequenceBlockWidth, sequenceBlockHeight);
-    sequence2Block->setBounds(0, startY + (sequenceBlockHeight + 10),     sequenceBlockWidth, sequenceBlockHeight);
-    sequence3Block->setBounds(0, startY + 2 * (sequenceBlockHeight + 10), sequenceBlockWidth, sequenceBlockHeight);
-    sequence4Block->setBounds(0, startY + 3 * (sequenceBlockHeight + 10), sequenceBlockWidth, sequenceBlockHeight);
+    int startY = 350;
 
-    sequence5Block->setBounds(sequenceBlockWidth + 20, startY,                                  sequenceBlockWidth, sequenceBlockHeight);
-    sequence6Block->setBounds(sequenceBlockWidth + 20, startY + (sequenceBlockHeight + 10),     sequenceBlockWidth, sequenceBlockHeight);
-    sequence7Block->setBounds(sequenceBlockWidth + 20, startY + 2 * (sequenceBlockHeight + 10), sequenceBlockWidth, sequenceBlockHeight);
-    sequence8Block->setBounds(sequenceBlockWidth + 20, startY + 3 * (sequenceBlockHeight + 10), sequenceBlockWidth, sequenceBlockHeight);
+    // the sequence list gets the rest (and scrolls)
+    sequenceList.setBounds(0, startY, getWidth(), juce::jmax(0, getHeight() - startY));
 }
@@ -13,12 +13,13 @@
 #include "SequenceUIBlock.h"
 #include "TempoUIBlock.h"
 #include "EventDetectorUIBlock.h"
+#include "EnvelopeView.h"
 
 
 //==============================================================================
 /**
 */
-class Assignment3AudioProcessorEditor : public juce::AudioProcessorEditor, public juce::Timer
+class Assignment3AudioProcessorEditor : public juce::AudioProcessorEditor, public juce::Timer, public juce::ListBoxModel
 {
 public:
     Assignment3AudioProcessorEditor(Assignment3AudioProcessor&);
@@ -27,6 +28,11 @@ public:
     //==============================================================================
     void timerCallback() override;
 
+    // the sequence list (see sequenceList below):
+    int getNumRows() override;
+    void paintListBoxItem(int rowNumber, juce::Graphics& g, int width, int height, bool rowIsSelected) override;
+    juce::Component* refreshComponentForRow(int rowNumber, bool isRowSelected, juce::Component* existingComponentToUpdate) override;
+
     void paint(juce::Graphics&) override;
     void resized() override;
 
@@ -39,15 +45,23 @@ private:
 
     std::unique_ptr<EventDetectorUIBlock> eventDetectorBlock;
     std::unique_ptr<TempoUIBlock> tempoBlock;
+    std::unique_ptr<EnvelopeView> envelopeView;
+    std::vector<EnvelopeColumn> envelopeColumns; // <- drained from the processor's EnvelopeTap every timer callback
     
-    std::unique_ptr<SequenceUIBlock> sequence1Block;
-    std::unique_ptr<SequenceUIBlock> sequence2Block;
-    std::unique_ptr<SequenceUIBlock> sequence3Block;
-    std::unique_ptr<SequenceUIBlock> sequence4Block;
-    std::unique_ptr<SequenceUIBlock> sequence5Block;
-    std::unique_ptr<SequenceUIBlock> sequence6Block;
-    std::unique_ptr<SequenceUIBlock> sequence7Block;
-    std::unique_ptr<SequenceUIBlock> sequence8Block;
+    // a row for each sequence in the processor's SequenceBank. The ListBox only has SequenceUIBlocks
+    // for the rows on screen, and re-points them at other sequences as it scrolls (so a session
+    // with lots of sequences doesn't mean lots of components)
+    juce::ListBox sequenceList;
+    std::vector<int> sequenceRows; // <- the SequenceBank slot shown in each row
+    const int sequenceRowHeight = 80; // <- room for the step grid between the text boxes
+    int numStatesLoaded = 0; // <- refill the rows when the processor loads a new state
+    void updateSequenceRows();
+
+    // drained from the processor's TelemetryStream every timer callback
+    std::vector<TelemetryFrame> telemetryFrames;
+    TelemetryFrame latestTelemetry;
+    int numOnsetsSeen = 0;
+    int numReleasesSeen = 0;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Assignment3AudioProcessorEditor)
 };
@@ -29,7 +29,10 @@ Assignment3AudioProcessor::Assignment3AudioProcessor()
         std::make_unique<juce::AudioParameterFloat>("detection_threshold", "Detection Threshold", -5.0, 10.0, 3.0),
         std::make_unique<juce::AudioParameterFloat>("release_detection_threshold", "Release Detection Threshold", -5.0, 10.0, 3.0),
         std::make_unique<juce::AudioParameterFloat>("event_on_beat_bias", "Event on beat bias", 0.0, 1.0, 1.0),
-        std::make_unique<juce::AudioParameterFloat>("tempo", "Tempo", 10, 200, 90)
+        std::make_unique<juce::AudioParameterFloat>("tempo", "Tempo", 10, 200, 90),
+        std::make_unique<juce::AudioParameterFloat>("sequence_look_ahead", "Sequence Look-ahead (ms)", 0.0, 50.0, 0.0),
+        std::make_unique<juce::AudioParameterBool>("look_ahead_analysis", "Look-ahead Analysis", false),
+        std::make_unique<juce::AudioParameterBool>("low_latency_onsets", "Low-latency Onsets", false)
         })
 {
     windowDurationParameter = parameters.getRawParameterValue("window_duration");
@@ -38,11 +41,20 @@ Assignment3AudioProcessor::Assignment3AudioProcessor()
     releaseDetectionThresholdParameter = parameters.getRawParameterValue("release_detection_threshold");
     eventOnBeatBiasParameter = parameters.getRawParameterValue("event_on_beat_bias");
     tempoParameter = parameters.getRawParameterValue("tempo");
+    lookAheadParameter = parameters.getRawParameterValue("sequence_look_ahead");
+    lookAheadAnalysisParameter = parameters.getRawParameterValue("look_ahead_analysis");
+    lowLatencyOnsetsParameter = parameters.getRawParameterValue("low_latency_onsets");
+
+    parameters.addParameterListener("look_ahead_analysis", this);
+    budgetLevelChanges.reserve(ProcessingBudget::logCapacity);
+    startTimer(100); // <- to apply latency changes and log the processing budget's level changes
 }
 
 
 Assignment3AudioProcessor::~Assignment3AudioProcessor()
 {
+    parameters.removeParameterListener("look_ahead_analysis", this);
+    stopTimer();
 }
 
 //==============================================================================
@@ -111,6 +123,14 @@ void Assignment3AudioProcessor::changeProgramName (int index, const juce::String
 void Assignment3AudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
     eventDetector.initialize(sampleRate, samplesPerBlock, 0.2f, 0.2f, 4, 1.0f); 
+    fastOnsetDetector.prepare(sampleRate);
+    analysisWorker.prepare(sampleRate);
+    processingBudget.prepare(sampleRate);
+    telemetry.prepare();
+    envelopeTap.prepare();
+    midiOutput.prepare(maxNotesPerBlock);
+    audioDelay.prepare(getTotalNumOutputChannels(), 8192); // <- the EventDetector's whole buffer, more than any latency it reports
+    updateLatency(); // <- (the sample rate may have changed)
       
     /*
     This if-statement seems like a cheeky work-around that should be improved at a later date.
@@ -128,7 +148,8 @@ void Assignment3AudioProcessor::prepareToPlay (double sampleRate, int samplesPer
         // otherwise: time to initialize everything:
 
         float tempo = *tempoParameter;
-        stateHandler.initialize(sampleRate, tempo, &eventDetector);
+        stateHandler.initialize(sampleRate, tempo, &eventDetector, maxNumSequences);
+        stateHandler.setAnalysisWorker(&analysisWorker);
         hasPrepareToPlayBeenCalledOnce = true;
 
         // below: - initialize sequence objects
@@ -140,64 +161,56 @@ void Assignment3AudioProcessor::prepareToPlay (double sampleRate, int samplesPer
         // initial Sequence objects
 
         // kick patterns --------------------------
-        sequence1.initialize(51, 60, 1, 4);
-        sequence1.setPatternValue(0, true);
-        sequence1.setPatternValue(3, true);
-        stateHandler.addSequence(&sequence1);
+        Sequence* sequence = stateHandler.getSequencePtr(stateHandler.addSequence(51, 60, 1, 4));
+        sequence->setPatternValue(0, true);
+        sequence->setPatternValue(3, true);
 
         
         // snare patterns -------------------------
 
         // 00001000
-        sequence2.initialize(39, 100, 2, 4);
-        sequence2.setPatternValue(4, true);
-        //sequence2.setPatternValue(7, true);
-        stateHandler.addSequence(&sequence2);
+        sequence = stateHandler.getSequencePtr(stateHandler.addSequence(39, 100, 2, 4));
+        sequence->setPatternValue(4, true);
+        //sequence->setPatternValue(7, true);
 
         // 0101010001010010
-        sequence3.initialize(38, 10, 4, 4);
-        sequence3.setPatternValue(1, true);
-        sequence3.setPatternValue(3, true);
-        sequence3.setPatternValue(5, true);
-        sequence3.setPatternValue(9, true);
-        sequence3.setPatternValue(11, true);
-        sequence3.setPatternValue(14, true);
-        stateHandler.addSequence(&sequence3);
+        sequence = stateHandler.getSequencePtr(stateHandler.addSequence(38, 10, 4, 4));
+        sequence->setPatternValue(1, true);
+        sequence->setPatternValue(3, true);
+        sequence->setPatternValue(5, true);
+        sequence->setPatternValue(9, true);
+        sequence->setPatternValue(11, true);
+        sequence->setPatternValue(14, true);
 
 
         // ========================================
         // hihat patterns -------------------------
 
-        sequence4.initialize(42, 100, 4, 2);
-        sequence4.setPatternValue(0, true);
-        sequence4.setPatternValue(2, true);
-        sequence4.setPatternValue(4, true);
-        sequence4.setPatternValue(6, true);
-        stateHandler.addSequence(&sequence4);
+        sequence = stateHandler.getSequencePtr(stateHandler.addSequence(42, 100, 4, 2));
+        sequence->setPatternValue(0, true);
+        sequence->setPatternValue(2, true);
+        sequence->setPatternValue(4, true);
+        sequence->setPatternValue(6, true);
 
-        sequence5.initialize(46, 110, 2, 2);
-        sequence5.setPatternValue(1, true);
-        sequence5.setPatternValue(3, true);
-        stateHandler.addSequence(&sequence5);
+        sequence = stateHandler.getSequencePtr(stateHandler.addSequence(46, 110, 2, 2));
+        sequence->setPatternValue(1, true);
+        sequence->setPatternValue(3, true);
 
         // low tom pattern ---------------------------
-        sequence6.initialize(41, 110, 1, 4);
-        sequence6.setPatternValue(0, true);
-        sequence6.setPatternValue(2, true);
-        sequence6.setPatternValue(3, true);
-        stateHandler.addSequence(&sequence6);
+        sequence = stateHandler.getSequencePtr(stateHandler.addSequence(41, 110, 1, 4));
+        sequence->setPatternValue(0, true);
+        sequence->setPatternValue(2, true);
+        sequence->setPatternValue(3, true);
 
         // ride ----------------------------
-        sequence7.initialize(53, 110, 1, 2);
-        sequence7.setPatternValue(0, true);
-        sequence7.setPatternValue(1, true);
-        stateHandler.addSequence(&sequence7);
+        sequence = stateHandler.getSequencePtr(stateHandler.addSequence(53, 110, 1, 2));
+        sequence->setPatternValue(0, true);
+        sequence->setPatternValue(1, true);
 
 
         // crash pattern -------------------------- 
-        sequence8.initialize(52, 110, 1, 2);
-        sequence8.setPatternValue(0, true);
-        stateHandler.addSequence(&sequence8);
+        sequence = stateHandler.getSequencePtr(stateHandler.addSequence(52, 110, 1, 2));
+        sequence->setPatternValue(0, true);
 
         // ==============================================================
         // after sequences added, need to turn an initial sequence on:
@@ -288,6 +301,24 @@ void Assignment3AudioProcessor::prepareToPlay (double sampleRate, int samplesPer
         and5.initialize(&not3, &amplitudeTransition1, {}, {}, false);
         setTriggerMidiTransition3.initialize(&stateHandler, &and5, true, { 0 }, { true }, false);
         stateHandler.addTransitionRule(&setTriggerMidiTransition3);
+
+        allRules = { &eventDensityTransition1, &eventDensityTransition2, &amplitudeTransition1, &amplitudeTransition2,
+                     &decreasingAmplitudeTransition1, &notDecreasingAmplitudeTransition1,
+                     &setTriggerMidiTransition1, &setTriggerMidiTransition2, &setTriggerMidiTransition3,
+                     &eventOnBeatTransition1, &eventOnBeatTransition2,
+                     &and1, &and2, &and3, &and4, &and5, &or1, &or2, &or3, &or4, &not1, &not2, &not3 };
+
+        // now there's something to load it into
+        if (pendingState.getSize() > 0)
+        {
+            StateSerializer::EngineState state;
+            if (StateSerializer::read(pendingState.getData(), (int)pendingState.getSize(), maxNumSequences, state))
+            {
+                StateSerializer::apply(state, getParameters(), stateHandler, allRules);
+                numStatesLoaded += 1;
+            }
+            pendingState.reset();
+        }
     }
 }
 
@@ -326,6 +357,7 @@ bool Assignment3AudioProcessor::isBusesLayoutSupported (const BusesLayout& layou
 void Assignment3AudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
     juce::ScopedNoDenormals noDenormals;
+    processingBudget.beginBlock();
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
@@ -345,23 +377,91 @@ void Assignment3AudioProcessor::processBlock (juce::AudioBuffer<float>& buffer,
     eventDetector.setReleaseDetectionThreshold(*releaseDetectionThresholdParameter);
     eventDetector.setEventOnBeatBias(*eventOnBeatBiasParameter);
     // stateHandler.setTempo(*tempoParameter); // <- doesn't work if wanting to adapt tempo
+    stateHandler.setLookAheadSamples((int)(*lookAheadParameter * 0.001 * getSampleRate()));
+
+    // in look-ahead analysis mode the audio is delayed by the latency reported to the host (see updateLatency())
+    bool lookAheadAnalysis = *lookAheadAnalysisParameter > 0.5f;
+    eventDetector.setLookAheadMode(lookAheadAnalysis);
+    int latencySamples = lookAheadAnalysis ? reportedLatencySamples.load() : 0;
+    stateHandler.setOutputLatencySamples(latencySamples);
+
+    // the degradation level the previous block left the processingBudget at (see the end of this function)
+    ProcessingBudget::Level budgetLevel = processingBudget.getLevel();
+    bool runFastOnsets = budgetLevel < ProcessingBudget::skipFastOnsets;
+    bool runEditorFeeds = budgetLevel < ProcessingBudget::skipOptionalFeatures;
+
+    // low-latency onsets don't make sense when the audio is being delayed anyway
+    bool lowLatencyOnsets = *lowLatencyOnsetsParameter > 0.5f && !lookAheadAnalysis && runFastOnsets;
 
     int numSamples = buffer.getNumSamples();
     // for now just assuming mono input on first channel
     float* leftChannel = buffer.getWritePointer(0);
     float* rightChannel = buffer.getWritePointer(1);
 
-    // update stuff:
+    // apply any edits made in the UI since the last block
+    stateHandler.applyEdits();
+
+    // update stuff (the slower analysis just gets a copy of the input, for its own thread):
+    analysisWorker.pushSamples(leftChannel, numSamples);
+    stateHandler.updateAnalysis();
     eventDetector.pushAudioBufferIntoBigBuffer(leftChannel, numSamples);
     eventDetector.detectHit();
+    int confirmationWindow = eventDetector.getLatencySamples() + numSamples;
+    fastOnsetDetector.setConfirmationWindow(confirmationWindow);
+    if (runFastOnsets) fastOnsetDetector.process(leftChannel, numSamples);
+    else fastOnsetDetector.skip(numSamples);
+    bool onsetConfirmed = eventDetector.getEventOccurring() && fastOnsetDetector.confirm(eventDetector.getOnsetSamplesAgo());
+    stateHandler.syncToHost(getPlayHead());
     stateHandler.updateState();
     stateHandler.updateTempo();
     stateHandler.updateSequences(numSamples); 
     
 
+    // every note is collected by the midiOutput stage, which writes them all out at the end
+    // (in order, without duplicates) along with their note-offs once their gate length has passed
+    juce::int64 eventGateInSamples = stateHandler.ticksToSamples(stateHandler.getEventGateLength());
+
+    // detected events go at the start of the block, or in look-ahead analysis mode, where
+    // their attack (or a release, its drop in level) comes out of the (delayed) audio - which can be in a later block
+    int eventOffset = 0;
+    int releaseOffset = 0;
+    if (lookAheadAnalysis)
+    {
+        eventOffset = juce::jmax(0, numSamples - eventDetector.getOnsetSamplesAgo() + latencySamples);
+        releaseOffset = juce::jmax(0, numSamples - eventDetector.getReleaseSamplesAgo() + latencySamples);
+    }
+
+    // in low-latency mode, an event's notes go out where the FastOnsetDetector fires instead
+    // (and not again when the EventDetector confirms it). Until then they're held on (so they're still
+    // sounding to be taken back), and then either ended at their normal gate length or, if the onset's
+    // retracted, cut straight away - just the notes that went out for it (see pendingOnsetNotes)
+    bool outputEventNotes = eventDetector.getEventOccurring();
+    int onsetOffset = eventOffset;
+    bool holdEventNotes = false;
+    if (lowLatencyOnsets)
+    {
+        if (fastOnsetDetector.hasFired())
+        {
+            outputEventNotes = true;
+            onsetOffset = fastOnsetDetector.getFireOffset();
+            holdEventNotes = !onsetConfirmed; // <- (unless it's been confirmed in the same block)
+        }
+        else if (onsetConfirmed)
+        {
+            outputEventNotes = false;
+            endPendingOnsetNotes(pendingOnsetSample + eventGateInSamples);
+        }
+
+        if (fastOnsetDetector.hasRetracted()) endPendingOnsetNotes(midiOutput.getSamplePosition(0));
+    }
+    else if (numPendingOnsetNotes > 0) endPendingOnsetNotes(pendingOnsetSample + eventGateInSamples); // <- (the mode's just been turned off)
+
     // create midi outputs for when rhythmic events are detected
-    if (eventDetector.getEventOccurring())
+    if (outputEventNotes)
     {
+        juce::int64 gateInSamples = holdEventNotes ? juce::jmax(eventGateInSamples, (juce::int64)(confirmationWindow + numSamples)) : eventGateInSamples;
+        if (holdEventNotes) pendingOnsetSample = midiOutput.getSamplePosition(onsetOffset);
+
         for (int i = 0; i < stateHandler.getEventMidiValues()->size(); i++)
         {
             if (stateHandler.getEventMidiValuesOn(i))
@@ -370,11 +470,13 @@ void Assignment3AudioProcessor::processBlock (juce::AudioBuffer<float>& buffer,
                 int midiValue = (*stateHandler.getEventMidiValues())[i];
                 juce::uint8 midiVelocity = (*stateHandler.getEventMidiVelocities())[i];
                 //DBG("eventMidi index: " << i);
-                auto noteOnMessage = juce::MidiMessage::noteOn(1, midiValue, midiVelocity);
-                auto noteOffMessage = juce::MidiMessage::noteOff(1, midiValue, midiVelocity);
+                midiOutput.addNote(onsetOffset, midiValue, midiVelocity, gateInSamples);
 
-                midiMessages.addEvent(noteOnMessage, 0);
-                midiMessages.addEvent(noteOffMessage, 1);
+                if (holdEventNotes && numPendingOnsetNotes < maxPendingOnsetNotes)
+                {
+                    pendingOnsetNotes[numPendingOnsetNotes] = midiValue;
+                    numPendingOnsetNotes += 1;
+                }
             } 
         }
         
@@ -391,31 +493,173 @@ void Assignment3AudioProcessor::processBlock (juce::AudioBuffer<float>& buffer,
                 int midiValue = (*stateHandler.getEventReleaseMidiValues())[i];
                 juce::uint8 midiVelocity = (*stateHandler.getEventReleaseMidiVelocities())[i];
                 //DBG("eventMidi index: " << i);
-                auto noteOnMessage = juce::MidiMessage::noteOn(1, midiValue, midiVelocity);
-                auto noteOffMessage = juce::MidiMessage::noteOff(1, midiValue, midiVelocity);
-
-                midiMessages.addEvent(noteOnMessage, 0);
-                midiMessages.addEvent(noteOffMessage, 1);
+                midiOutput.addNote(releaseOffset, midiValue, midiVelocity, eventGateInSamples);
             }
         }
     }
 
-    // generate the sequencer midi outputs
-    for (int i = 0; i < stateHandler.getNumSequences(); i++)
+    // generate the sequencer midi outputs: only the sequences the
+    // StateHandler has scheduled a hit for in this block
+    for (int d = 0; d < stateHandler.getNumDueHits(); d++)
     {
-        if (stateHandler.getSequencePtr(i)->isOutputting())
-        {
-            int midiValue = stateHandler.getSequencePtr(i)->getMidiValue();
-            juce::uint8 midiVelocity = stateHandler.getSequencePtr(i)->getMidiVelocity();
-            
-            auto noteOnMessage = juce::MidiMessage::noteOn(1, midiValue, midiVelocity); 
-            auto noteOffMessage = juce::MidiMessage::noteOff(1, midiValue, midiVelocity);
-
-            midiMessages.addEvent(noteOnMessage, 0);
-            midiMessages.addEvent(noteOffMessage, 1);
-        }
-        
+        StateHandler::SequenceHit hit = stateHandler.getDueHit(d);
+        Sequence* sequence = stateHandler.getSequencePtr(hit.sequence);
+
+        int midiValue = sequence->getMidiValue();
+        juce::uint8 midiVelocity = sequence->getStepVelocity(hit.step);
+        int sampleOffset = stateHandler.getSampleOffset(hit.tick, numSamples);
+        juce::int64 gateInSamples = stateHandler.ticksToSamples(sequence->getStepGateLength(hit.step));
+
+        midiOutput.addNote(sampleOffset, midiValue, midiVelocity, gateInSamples);
+    }
+
+    // write the block's notes and note-offs into midiMessages
+    midiOutput.writeBlock(midiMessages, numSamples);
+
+    // and delay the audio (if reporting latency - setDelay() does nothing unless the mode's just changed)
+    audioDelay.setDelay(latencySamples);
+    audioDelay.process(buffer);
+
+    // the output's envelope, decimated for the editor - after the delay, so it's in the same timebase as
+    // the notes (the onset / release offsets already are, and the beats are shifted along like the sequences)
+    if (runEditorFeeds)
+    {
+        const BeatGrid& beatGrid = stateHandler.getBeatGrid();
+        int beatOffset = beatGrid.getNumBoundaries(1) > 0 ? beatGrid.getBoundaryOffset(1, 0) + latencySamples : -1;
+        envelopeTap.process(leftChannel, numSamples, eventDetector.getDetectionRatio(),
+                            outputEventNotes ? onsetOffset : -1, eventDetector.getEventReleaseOccurring() ? releaseOffset : -1, beatOffset);
+    }
+
+    if (runEditorFeeds) publishTelemetry(numSamples, outputEventNotes, onsetOffset, eventDetector.getEventReleaseOccurring(), releaseOffset);
+
+    // step down (or back up) through the degradation levels, for the next block
+    ProcessingBudget::Level level = processingBudget.endBlock(numSamples);
+    eventDetector.setConfigurationsEnabled(level < ProcessingBudget::skipOptionalFeatures);
+    analysisWorker.setAnalysisInterval(level >= ProcessingBudget::skipFastOnsets ? 20 : 5);
+    stateHandler.setRuleEvaluationInterval(level >= ProcessingBudget::rulesEveryOtherBlock ? 2 : 1);
+}
+
+/*
+Report the look-ahead analysis latency to the host: the 'after' half of the longest window the
+window_duration parameter allows, so that it doesn't move as the window's adjusted (the detected
+events are placed relative to it, wherever in the window they're found).
+*/
+void Assignment3AudioProcessor::updateLatency()
+{
+    int latencySamples = 0;
+    if (*lookAheadAnalysisParameter > 0.5f && getSampleRate() > 0.0)
+    {
+        float maxWindowDuration = parameters.getParameterRange("window_duration").end;
+        latencySamples = EventDetector::getLookAheadLatencySamples(getSampleRate(), maxWindowDuration);
     }
+
+    reportedLatencySamples.store(latencySamples);
+    if (latencySamples != getLatencySamples()) setLatencySamples(latencySamples);
+}
+
+/*
+This can be called on any thread (e.g. the audio thread, under host automation), so it only
+flags the change - updateLatency() is then called from timerCallback(), on the message thread.
+*/
+void Assignment3AudioProcessor::parameterChanged(const juce::String& parameterID, float newValue)
+{
+    if (parameterID == "look_ahead_analysis") latencyNeedsUpdate.store(true);
+}
+
+/*
+End the notes held on for the FastOnsetDetector's onset (confirmed or not) by a sample position -
+each only if it's still the note that went out for the onset.
+*/
+void Assignment3AudioProcessor::endPendingOnsetNotes(juce::int64 noteOffSample)
+{
+    for (int i = 0; i < numPendingOnsetNotes; i++)
+    {
+        midiOutput.endNoteBy(pendingOnsetNotes[i], pendingOnsetSample, noteOffSample);
+    }
+    numPendingOnsetNotes = 0;
+}
+
+float Assignment3AudioProcessor::getFastOnsetLatencyMs()
+{
+    return fastOnsetDetector.getMeasuredLatencyMs();
+}
+
+void Assignment3AudioProcessor::timerCallback()
+{
+    if (latencyNeedsUpdate.exchange(false)) updateLatency();
+    logProcessingBudgetChanges();
+}
+
+/*
+Write any processing-budget level changes to the log file (message thread, on the processor's
+own timer - so changes are logged whether or not the editor's open). The file's only created
+once there's something to write to it.
+*/
+void Assignment3AudioProcessor::logProcessingBudgetChanges()
+{
+    processingBudget.readLevelChanges(budgetLevelChanges);
+    int numDropped = processingBudget.getNumDroppedLevelChanges();
+    if (numDropped < numBudgetChangesDropped) numBudgetChangesDropped = 0; // <- (the count starts again when the budget's re-prepared)
+    if (budgetLevelChanges.empty() && numDropped == numBudgetChangesDropped) return;
+
+    if (budgetLogger == nullptr)
+    {
+        budgetLogger.reset(juce::FileLogger::createDefaultAppLogger(JucePlugin_Name, "ProcessingBudget.log", "Processing budget level changes"));
+    }
+
+    for (auto& change : budgetLevelChanges)
+    {
+        budgetLogger->logMessage("Processing budget: block " + juce::String(change.block) + ", "
+            + ProcessingBudget::getLevelName(change.fromLevel) + " -> " + ProcessingBudget::getLevelName(change.toLevel)
+            + " (load " + juce::String((int)(change.load * 100.0f)) + "%)");
+    }
+
+    if (numDropped != numBudgetChangesDropped)
+    {
+        budgetLogger->logMessage("Processing budget: " + juce::String(numDropped - numBudgetChangesDropped) + " more level changes weren't logged");
+        numBudgetChangesDropped = numDropped;
+    }
+}
+
+int Assignment3AudioProcessor::getNumStatesLoaded()
+{
+    return numStatesLoaded;
+}
+
+void Assignment3AudioProcessor::readTelemetry(std::vector<TelemetryFrame>& frames)
+{
+    telemetry.readFrames(frames);
+}
+
+void Assignment3AudioProcessor::readEnvelope(std::vector<EnvelopeColumn>& columns)
+{
+    envelopeTap.readColumns(columns);
+}
+
+/*
+Fill in and publish this block's TelemetryFrame (audio thread, at the end of processBlock).
+*/
+void Assignment3AudioProcessor::publishTelemetry(int numSamples, bool onset, int onsetOffset, bool release, int releaseOffset)
+{
+    TelemetryFrame* frame = telemetry.beginFrame(numSamples);
+    if (frame == nullptr) return; // <- nobody's reading (the editor's closed), or it's fallen behind
+
+    frame->volume = eventDetector.getRecentVolume(numSamples);
+    frame->density = eventDetector.getDensity();
+    frame->tempo = stateHandler.getTempo();
+    frame->beatPosition = stateHandler.getBeatPosition();
+    frame->onset = onset;
+    frame->onsetOffset = onsetOffset;
+    frame->release = release;
+    frame->releaseOffset = releaseOffset;
+
+    frame->numSequences = juce::jmin(stateHandler.getNumSequences(), TelemetryFrame::maxNumSequences);
+    for (int i = 0; i < frame->numSequences; i++)
+    {
+        frame->sequenceStates[i] = (juce::int8)(stateHandler.isSequenceInUse(i) ? stateHandler.getState(i) : StateHandler::State::off);
+    }
+
+    telemetry.endFrame();
 }
 
 //==============================================================================
@@ -437,9 +681,25 @@ void Assignment3AudioProcessor::getStateInformation (juce::MemoryBlock& destData
     // You could do that either as raw data, or use the XML or ValueTree classes
     // as intermediaries to make it easy to save and load complex data.
 
-    auto state = parameters.copyState();
-    std::unique_ptr<juce::XmlElement> xml(state.createXml());
-    copyXmlToBinary(*xml, destData);
+    /*
+    Everything (parameters, sequences, midi mappings, rule settings) goes in one binary block -
+    see StateSerializer.h. This reads the StateHandler while the audio thread may be running,
+    like the UI does, so a sequence changing state at that exact moment could be saved either way.
+    */
+    if (hasPrepareToPlayBeenCalledOnce)
+    {
+        StateSerializer::write(destData, getParameters(), stateHandler, allRules);
+    }
+    else if (pendingState.getSize() > 0)
+    {
+        destData = pendingState; // <- not loaded yet, so just hand it back
+    }
+    else
+    {
+        auto state = parameters.copyState();
+        std::unique_ptr<juce::XmlElement> xml(state.createXml());
+        copyXmlToBinary(*xml, destData);
+    }
 }
 
 void Assignment3AudioProcessor::setStateInformation (const void* data, int sizeInBytes)
@@ -447,6 +707,26 @@ void Assignment3AudioProcessor::setStateInformation (const void* data, int sizeI
     // You should use this method to restore your parameters from this memory block,
     // whose contents will have been created by the getStateInformation() call.
 
+    if (StateSerializer::isEngineState(data, sizeInBytes))
+    {
+        if (!hasPrepareToPlayBeenCalledOnce)
+        {
+            pendingState.replaceAll(data, (size_t)sizeInBytes);
+            return;
+        }
+
+        // validate everything before touching anything
+        StateSerializer::EngineState state;
+        if (!StateSerializer::read(data, sizeInBytes, maxNumSequences, state)) return;
+
+        suspendProcessing(true);
+        StateSerializer::apply(state, getParameters(), stateHandler, allRules);
+        numStatesLoaded += 1;
+        suspendProcessing(false);
+        return;
+    }
+
+    // older sessions: just the parameters, as xml
     std::unique_ptr<juce::XmlElement> xmlState(getXmlFromBinary(data, sizeInBytes));
     if (xmlState.get() != nullptr)
     {
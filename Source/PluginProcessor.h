@@ -13,12 +13,22 @@
 #include "StateHandler.h"
 #include "Sequence.h"
 #include "CustomTransitionRules.h"
+#include "MidiOutputStage.h"
+#include "AudioDelay.h"
+#include "FastOnsetDetector.h"
+#include "AnalysisWorker.h"
+#include "ProcessingBudget.h"
+#include "StateSerializer.h"
+#include "TelemetryStream.h"
+#include "EnvelopeTap.h"
 
 
 //==============================================================================
 /**
 */
-class Assignment3AudioProcessor  : public juce::AudioProcessor
+class Assignment3AudioProcessor  : public juce::AudioProcessor,
+                                   public juce::AudioProcessorValueTreeState::Listener,
+                                   private juce::Timer
                             #if JucePlugin_Enable_ARA
                              , public juce::AudioProcessorARAExtension
                             #endif
@@ -61,6 +71,29 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
 
+    //==============================================================================
+    /*
+    How long after an attack the low-latency onset detection is firing, on average (for the UI).
+    */
+    float getFastOnsetLatencyMs();
+
+    /*
+    How many times a saved state has been loaded into the StateHandler (the editor
+    rebuilds its sequence blocks when this changes).
+    */
+    int getNumStatesLoaded();
+
+    /*
+    Move the TelemetryFrames published since the last call into frames (message thread - the
+    editor drains these on its timer, rather than reading the StateHandler directly).
+    */
+    void readTelemetry(std::vector<TelemetryFrame>& frames);
+
+    /*
+    As above, for the decimated output envelope (for the editor's EnvelopeView).
+    */
+    void readEnvelope(std::vector<EnvelopeColumn>& columns);
+
 
     //====================================================================================
     // I have a couple of public variables here, because it feels weirder to make
@@ -86,11 +119,16 @@ private:
     std::atomic<float>* releaseDetectionThresholdParameter;
     std::atomic<float>* eventOnBeatBiasParameter;
     std::atomic<float>* tempoParameter;
+    std::atomic<float>* lookAheadParameter;
+    std::atomic<float>* lookAheadAnalysisParameter;
+    std::atomic<float>* lowLatencyOnsetsParameter;
 
     // ====================================
     // all the relevent custom class stuff:
 
     EventDetector eventDetector;
+    FastOnsetDetector fastOnsetDetector; // <- fires event notes early, confirmed by the eventDetector
+    AnalysisWorker analysisWorker; // <- the slower analysis, on its own thread
 
     EventDensityTransition eventDensityTransition1;
     EventDensityTransition eventDensityTransition2;
@@ -117,12 +155,49 @@ private:
     NotTransition not2;
     NotTransition not3;
 
-    Sequence sequence1;
-    Sequence sequence2;
-    Sequence sequence3;
-    Sequence sequence4;
-    Sequence sequence5;
-    Sequence sequence6;
-    Sequence sequence7;
-    Sequence sequence8;
+    // every rule above, in a fixed order (for saving / loading their settings)
+    std::vector<TransitionRule*> allRules;
+
+    // a state loaded before the first prepareToPlay (when there's nothing to load it into yet)
+    juce::MemoryBlock pendingState;
+    int numStatesLoaded = 0; // <- message thread's
+
+    // the Sequence objects themselves live in the StateHandler's SequenceBank,
+    // which gets this capacity when first prepared (enough for full kits with variations)
+    static constexpr int maxNumSequences = 128;
+
+    // all the midi output goes through here (notes from every source, and their note-offs)
+    static constexpr int maxNotesPerBlock = 256;
+    MidiOutputStage midiOutput;
+
+    // the notes that went out for the FastOnsetDetector's onset, held on until it's confirmed or retracted
+    static constexpr int maxPendingOnsetNotes = 32;
+    int pendingOnsetNotes[maxPendingOnsetNotes] = {};
+    int numPendingOnsetNotes = 0;
+    juce::int64 pendingOnsetSample = 0; // <- where they started (see MidiOutputStage::getSamplePosition())
+    void endPendingOnsetNotes(juce::int64 noteOffSample);
+
+    // delays the audio pass-through by the reported latency in look-ahead analysis mode
+    AudioDelay audioDelay;
+
+    // the latency reported to the host: fixed while look-ahead analysis is on (the longest
+    // window's), so it's only set when the mode or sample rate changes, never per block
+    // (and when the mode changes, on the message thread - see parameterChanged())
+    std::atomic<int> reportedLatencySamples { 0 };
+    std::atomic<bool> latencyNeedsUpdate { false };
+    void updateLatency();
+    void parameterChanged(const juce::String& parameterID, float newValue) override;
+
+    // times each block, and cuts back on the optional work when they get too slow
+    ProcessingBudget processingBudget;
+    std::vector<ProcessingBudget::LevelChange> budgetLevelChanges; // <- message thread's
+    std::unique_ptr<juce::FileLogger> budgetLogger; // <- created when there's first a change to log
+    int numBudgetChangesDropped = 0;
+    void logProcessingBudgetChanges();
+    void timerCallback() override;
+
+    // what the engine saw and did in each block, for the editor
+    TelemetryStream telemetry;
+    void publishTelemetry(int numSamples, bool onset, int onsetOffset, bool release, int releaseOffset);
+    EnvelopeTap envelopeTap;
 };
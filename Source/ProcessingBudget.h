@@ -0,0 +1,211 @@
+/*
+  ==============================================================================
+
+    ProcessingBudget.h
+    Created: 18 Oct 2026 11:24:37pm
+    Author:  User
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+
+/*
+A ProcessingBudget times each processBlock() call against the block's real-time budget (the
+time the block's audio lasts), and steps the plugin through 'degradation levels' when it's
+running too close to it - so a few slow blocks don't turn into audible dropouts:
+
+  - normal:                 everything runs,
+  - skipOptionalFeatures:   the editor's feeds (TelemetryFrames and EnvelopeColumns) aren't written,
+                            and the EventDetector's extra configurations (if any) aren't evaluated,
+  - skipFastOnsets:         ...and the FastOnsetDetector's per-sample pass is skipped (low-latency
+                            onsets wait for the EventDetector), and the AnalysisWorker only looks
+                            for new input every 20 ms,
+  - rulesEveryOtherBlock:   ...and the TransitionRules are only evaluated every other block.
+
+Any block using more than budgetFraction of its budget steps up a level straight away. Once the
+load has stayed below half of that for recoveryDuration, it steps back down one level (and so on).
+
+Every level change is logged into a small lock-free FIFO (the audio thread can't write to a file),
+which the message thread reads with readLevelChanges() - the processor drains it on its own timer
+into a log file, whether or not the editor's open. If the FIFO does fill up, the changes which
+didn't fit are counted (getNumDroppedLevelChanges()), so the log can at least say so.
+*/
+class ProcessingBudget
+{
+public:
+
+    enum Level { normal = 0, skipOptionalFeatures, skipFastOnsets, rulesEveryOtherBlock, numLevels };
+
+    /*
+    A logged change of level: the block it happened in, the levels, and the load
+    (the fraction of the budget used by the block which caused it).
+    */
+    struct LevelChange
+    {
+        juce::int64 block;
+        int fromLevel;
+        int toLevel;
+        float load;
+    };
+
+    static constexpr int logCapacity = 64;
+
+    ProcessingBudget() : logFifo(logCapacity), log(logCapacity)
+    {
+    }
+
+    void prepare(double _sampleRate)
+    {
+        sampleRate = _sampleRate;
+        level = normal;
+        blockIndex = 0;
+        secondsUnderBudget = 0.0;
+        maxLoad.store(0.0f);
+        droppedLevelChanges.store(0);
+    }
+
+    /*
+    The fraction (0.0 to 1.0) of a block's real-time budget that processBlock() can use
+    before the next degradation level kicks in.
+    */
+    void setBudgetFraction(float _budgetFraction)
+    {
+        budgetFraction = juce::jlimit(0.05f, 1.0f, _budgetFraction);
+    }
+
+    // =========================
+    // audio thread:
+
+    /*
+    Call this first thing in processBlock().
+    */
+    void beginBlock()
+    {
+        blockStartTicks = juce::Time::getHighResolutionTicks();
+    }
+
+    /// <summary>
+    /// Call this last thing in processBlock(): times the block and changes level if needed.
+    /// </summary>
+    /// <param name="numSamples"> the number of samples in the block.</param>
+    /// <returns> the degradation level for the next block.</returns>
+    Level endBlock(int numSamples)
+    {
+        double elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - blockStartTicks);
+        double budget = numSamples / sampleRate;
+        float load = budget > 0.0 ? (float)(elapsed / budget) : 0.0f;
+
+        if (load > maxLoad.load()) maxLoad.store(load);
+        lastLoad.store(load);
+
+        if (load > budgetFraction)
+        {
+            secondsUnderBudget = 0.0;
+            if (level < numLevels - 1) changeLevel((Level)(level + 1), load);
+        }
+        else if (load < 0.5f * budgetFraction)
+        {
+            secondsUnderBudget += budget;
+            if (secondsUnderBudget >= recoveryDuration && level > normal)
+            {
+                secondsUnderBudget = 0.0;
+                changeLevel((Level)(level - 1), load);
+            }
+        }
+        else secondsUnderBudget = 0.0;
+
+        blockIndex += 1;
+        return level;
+    }
+
+    Level getLevel()
+    {
+        return level;
+    }
+
+    // =========================
+    // message thread:
+
+    /*
+    Move any logged level changes into changes (which is cleared first).
+    */
+    void readLevelChanges(std::vector<LevelChange>& changes)
+    {
+        changes.clear();
+
+        int start1, size1, start2, size2;
+        logFifo.prepareToRead(logFifo.getNumReady(), start1, size1, start2, size2);
+        for (int i = 0; i < size1; i++) changes.push_back(log[start1 + i]);
+        for (int i = 0; i < size2; i++) changes.push_back(log[start2 + i]);
+        logFifo.finishedRead(size1 + size2);
+    }
+
+    /*
+    The load of the most recent block, and the highest so far (for display).
+    */
+    float getLastLoad()
+    {
+        return lastLoad.load();
+    }
+
+    float getMaxLoad()
+    {
+        return maxLoad.load();
+    }
+
+    /*
+    How many level changes couldn't be logged because the FIFO was full (since prepare()).
+    */
+    int getNumDroppedLevelChanges()
+    {
+        return droppedLevelChanges.load();
+    }
+
+    static const char* getLevelName(int _level)
+    {
+        switch (_level)
+        {
+        case normal:               return "normal";
+        case skipOptionalFeatures: return "skip optional features";
+        case skipFastOnsets:       return "skip fast onsets";
+        case rulesEveryOtherBlock: return "rules every other block";
+        default:                   return "unknown";
+        }
+    }
+
+private:
+    double sampleRate = 44100.0;
+    float budgetFraction = 0.7f;
+    const double recoveryDuration = 2.0; // seconds
+
+    Level level = normal;
+    juce::int64 blockIndex = 0;
+    juce::int64 blockStartTicks = 0;
+    double secondsUnderBudget = 0.0;
+
+    std::atomic<float> lastLoad { 0.0f };
+    std::atomic<float> maxLoad { 0.0f };
+
+    // level changes (audio thread -> message thread); if it's full, changes are only counted
+    juce::AbstractFifo logFifo;
+    std::vector<LevelChange> log;
+    std::atomic<int> droppedLevelChanges { 0 };
+
+    void changeLevel(Level newLevel, float load)
+    {
+        int start1, size1, start2, size2;
+        logFifo.prepareToWrite(1, start1, size1, start2, size2);
+        if (size1 > 0)
+        {
+            log[start1] = { blockIndex, (int)level, (int)newLevel, load };
+            logFifo.finishedWrite(1);
+        }
+        else droppedLevelChanges.fetch_add(1);
+
+        level = newLevel;
+    }
+};
@@ -11,11 +11,58 @@
 #pragma once
 
 #include <vector>
+#include "Transport.h"
+#include "StepPattern.h"
+#include "SequenceScheduler.h"
+#include "PatternParser.h"
 
+/*
+The data of every Sequence in a SequenceBank, stored field by field: one contiguous array per
+field, indexed by slot (a 'structure of arrays'). The StepPatterns are big (their per-step lanes),
+so keeping them apart from the small per-sequence values means that going through every sequence's
+midi note, say, reads one short array rather than striding across all the patterns.
+*/
+struct SequenceFields
+{
+    std::vector<StepPattern> patterns;
+    std::vector<int> patternSizes;
+    std::vector<int> numBeats;
+    std::vector<int> numBeatDivisions;
+    std::vector<int> midiValues;
+    std::vector<int> midiVelocities;
+    std::vector<int> gateLengths;
+    std::vector<int> scheduledSteps;
+    std::vector<juce::uint32> randomStates;
+
+    /*
+    Allocate every array (message thread / prepareToPlay only).
+    */
+    void allocate(int capacity)
+    {
+        patterns.assign(capacity, StepPattern());
+        patternSizes.assign(capacity, 0);
+        numBeats.assign(capacity, 0);
+        numBeatDivisions.assign(capacity, 0);
+        midiValues.assign(capacity, 0);
+        midiVelocities.assign(capacity, 0);
+        gateLengths.assign(capacity, Transport::ticksPerBeat / 8);
+        scheduledSteps.assign(capacity, -1);
+        randomStates.assign(capacity, 2463534242u);
+    }
+};
+
+/*
+A Sequence is a handle onto one slot of a SequenceBank's SequenceFields: it holds no data itself,
+just where its data is, so everything below reads and writes the bank's arrays.
+*/
 class Sequence
 {
 public:
 
+    Sequence(SequenceFields* _fields, int _slot) : fields(_fields), slot(_slot)
+    {
+    }
+
     /// <summary>
     /// Initialize this Sequence.
     /// </summary>
@@ -25,234 +72,289 @@ public:
     /// <param name="_numBeatDivisions"> the total number of sub-divisions each beat has.</param>
     void initialize(int _midiValue, int _midiVelocity, int _numBeats, int _numBeatDivisions)
     {
-        midiValue = _midiValue;
-        midiVelocity = _midiVelocity;
-        numBeats = _numBeats;
-        numBeatDivisions = _numBeatDivisions;
-        patternSize = numBeats*numBeatDivisions;
-        pattern.clear(); // <- incase initialize() called more than once by a prepareToPlay() function
-        for (int i = 0; i < patternSize; i++)
-        {
-            pattern.push_back(false);
-        }
-        prevIndex = -1;
-
+        midiValue() = _midiValue;
+        midiVelocity() = _midiVelocity;
+        numBeats() = _numBeats;
+        numBeatDivisions() = _numBeatDivisions;
+        pattern().clear(); // <- incase initialize() called more than once by a prepareToPlay() function
+        pattern().setSize(numBeats() * numBeatDivisions());
+        patternSize() = pattern().getSize();
+        scheduledStep() = -1;
+        randomState() = 2463534242u + (juce::uint32)midiValue(); // <- just needs to be non-zero
+        gateLength() = juce::jmax(1, (Transport::ticksPerBeat / juce::jmax(1, numBeatDivisions())) / 2); // <- half a step
     }
 
     /// <summary>
-    /// Set the pattern from a String provided in the UI.
+    /// Set the pattern from a String (see PatternParser for the syntax).
     /// </summary>
-    /// <param name="inputText"> the String provided in the UI.</param>
-    void setPatternFromString(juce::String inputText)
+    /// <param name="inputText"> the pattern String.</param>
+    /// <returns> false (leaving the pattern as it was) if the String isn't a valid pattern.</returns>
+    bool setPatternFromString(const juce::String& inputText)
     {
-        int newPatternLength = 0;
-        if (inputText.length() > patternSize)
-        {
-            // not ideal ^, so just limit it to patternSize (numBeats * numBeatDivisions)
-            newPatternLength = patternSize;
-        }
-        else
+        return PatternParser::parse(inputText, pattern());
+    }
+
+    /*
+    The inverse of setPatternFromString(): used to show the pattern in the UI.
+    */
+    juce::String getPatternAsString()
+    {
+        juce::String patternString = "";
+        for (int i = 0; i < patternSize(); i++)
         {
-            newPatternLength = inputText.length();
-            for (int i = 0; i < newPatternLength; i++)
-            {
-                if (inputText.substring(i,i+1).equalsIgnoreCase("0"))
-                {
-                    setPatternValue(i, false);
-                }
-                else
-                {
-                    setPatternValue(i, true);
-                }
-            }
+            if (pattern().getStep(i)) patternString += 1;
+            else patternString += 0;
 
-            // append extra zeros / falses if not enough text input provided.
-            for (int i = newPatternLength; i < patternSize; i++)
+            if (pattern().hasLaneValues(i))
             {
-                setPatternValue(i, false);
+                patternString += "[v" + juce::String(pattern().getStepVelocity(i))
+                    + " p" + juce::String(pattern().getStepProbability(i))
+                    + " o" + juce::String(pattern().getStepOffset(i))
+                    + " g" + juce::String(pattern().getStepGate(i)) + "]";
             }
-        } 
+        }
+        return patternString;
     }
 
     /// <summary>
-    /// Set the number of beats from a TextEditor String in the UI.
+    /// Replace the pattern (and length) with one prepared elsewhere. Called on the audio thread
+    /// when applying an edit from the UI: just a bounded copy, nothing is allocated.
     /// </summary>
-    /// <param name="inputText"> the String from the UI component to use.</param>
-    void setNumBeatsFromString(juce::String inputText)
+    /// <param name="_numBeats"> the new number of beats.</param>
+    /// <param name="_numBeatDivisions"> the new number of beat divisions.</param>
+    /// <param name="newPattern"> the new pattern (already sized to numBeats * numBeatDivisions).</param>
+    void applyPattern(int _numBeats, int _numBeatDivisions, const StepPattern& newPattern)
     {
-        if (isNumber(inputText))
-        {
-            numBeats = std::stoi(inputText.toStdString());
-            resizePatternVector(numBeats * numBeatDivisions);
-        }
+        numBeats() = _numBeats;
+        numBeatDivisions() = _numBeatDivisions;
+        pattern().copyFrom(newPattern);
+        patternSize() = pattern().getSize();
     }
 
     /// <summary>
-    /// Set the number of beat divisions from a TextEditor String in the UI.
+    /// Find the tick position of this Sequence's next hit strictly after a given tick, assuming the
+    /// Sequence plays along with the shared Transport (i.e. step 0 lines up with tick 0), including
+    /// the hit's micro-timing offset. The step found is remembered (see getScheduledStep()). All
+    /// integer maths, so this never drifts. Used by the StateHandler to schedule sequences.
     /// </summary>
-    /// <param name="inputText"> the String from the UI component to use.</param>
-    void setNumBeatDivisionsFromString(juce::String inputText)
+    /// <param name="tick"> the tick position to search after.</param>
+    /// <returns> the tick of the next active step, or SequenceScheduler::never if the pattern is empty.</returns>
+    juce::int64 scheduleNextHit(juce::int64 tick)
     {
-        if (inputText.length() > 0)
+        if (patternSize() <= 0 || numBeatDivisions() <= 0 || pattern().nextHitAfter(-1) < 0) return SequenceScheduler::never;
+
+        // which step are we on (multiplying before dividing keeps it exact even
+        // if numBeatDivisions doesn't divide ticksPerBeat)
+        juce::int64 stepsElapsed = Transport::floorDiv(tick * numBeatDivisions(), Transport::ticksPerBeat);
+
+        // offsets are kept within half a step, so the hit for the previous step could
+        // still be ahead of tick (played late) - start looking from there.
+        juce::int64 step = nextHitStepAfter(stepsElapsed - 2);
+        while (stepHitTick(step) <= tick)
         {
-            if (isNumber(inputText))
-            {
-                numBeatDivisions = std::stoi(inputText.toStdString());
-                resizePatternVector(numBeats * numBeatDivisions);
-            }
+            step = nextHitStepAfter(step);
         }
+
+        scheduledStep() = (int)Transport::floorMod(step, patternSize());
+        return stepHitTick(step);
     }
 
-    /// <summary>
-    /// Set the midi value for the Sequence from a TextEditor String in the UI.
-    /// </summary>
-    /// <param name="midiValueString"> the String from the UI component to use.</param>
-    void setMidiValueFromString(juce::String midiValueString)
+    // =========================
+    // the Sequence's own loop (numBeats long): loops line up with tick 0 of the shared Transport,
+    // as the scheduling does - so a 3, 5 or 7 beat Sequence loops cleanly forever alongside a
+    // 4 beat one (polymeter), worked out from the tick position alone with no per-block state.
+
+    juce::int64 getLoopLengthInTicks()
     {
-        if (isNumber(midiValueString))
-        {
-            midiValue = stringToInt(midiValueString);
-        }
+        return (juce::int64)numBeats() * Transport::ticksPerBeat;
     }
 
-    /// <summary>
-    /// Set the midi velocity for the Sequence from a TextEditor String in the UI.
-    /// </summary>
-    /// <param name="midiVelString"> the String from the UI component to use.</param>
-    void setMidiVelocityFromString(juce::String midiVelString)
+    /*
+    The tick the Sequence next loops back to its start, strictly after a given tick.
+    */
+    juce::int64 nextLoopStartAfter(juce::int64 tick)
     {
-        if (isNumber(midiVelString))
-        {
-            midiVelocity = stringToInt(midiVelString);
-        }
+        juce::int64 loopLength = getLoopLengthInTicks();
+        if (loopLength <= 0) return tick + 1;
+
+        return tick - Transport::floorMod(tick, loopLength) + loopLength;
     }
 
     /*
-    Returns true or false for if sequence is outputting a midi note at current moment.
-    If has returned true once, then makes sure True can't be returned until next() sets currentOutput to True again.
+    The tick the next step (active or not) starts at, strictly after a given tick.
     */
-    bool isOutputting()
+    juce::int64 nextStepStartAfter(juce::int64 tick)
     {
-        int beatNo = ((int)fmod(beatPosition, numBeats));
-        int subBeatNo = (int)(fmod(beatPosition, 1.0f) * numBeatDivisions);
-        int currentIndex = (numBeatDivisions * beatNo) + subBeatNo;
+        if (numBeatDivisions() <= 0) return tick + 1;
 
-        if (prevIndex == currentIndex) return false;
-        else
-        {
-            setPrevIndex(currentIndex);
-            return pattern[currentIndex];
-        }
+        juce::int64 step = Transport::floorDiv(tick * numBeatDivisions(), Transport::ticksPerBeat);
+        while (stepStartTick(step) <= tick) step++;
+        return stepStartTick(step);
+    }
+
+    /*
+    The step (index into the pattern) of the hit found by the last scheduleNextHit() call.
+    */
+    int getScheduledStep()
+    {
+        return scheduledStep();
+    }
+
+    /*
+    Roll the dice (with this Sequence's own random number generator) for whether
+    a step triggers, using the step's probability.
+    */
+    bool shouldTrigger(int step)
+    {
+        int probability = pattern().getStepProbability(step);
+        if (probability >= 100) return true;
+        if (probability <= 0) return false;
+        return (nextRandom() % 100) < (juce::uint32)probability;
+    }
+
+    /*
+    The midi velocity for a step: the step's own velocity if it has one, otherwise the Sequence's.
+    */
+    int getStepVelocity(int step)
+    {
+        int velocity = pattern().getStepVelocity(step);
+        return (velocity == StepPattern::defaultVelocity) ? midiVelocity() : velocity;
+    }
+
+    /*
+    The gate length (in ticks) for a step: the step's own gate if it has one, otherwise the Sequence's.
+    */
+    int getStepGateLength(int step)
+    {
+        int gate = pattern().getStepGate(step);
+        return (gate == StepPattern::defaultGate) ? gateLength() : gate;
     }
 
     // =========================
     // some getters and setters:
 
-    std::vector<bool>* getPatternPtr()
+    StepPattern* getPatternPtr()
     {
-        return &pattern;
+        return &pattern();
     }
 
     void setPatternValue(int index, bool value)
     {
-        pattern[index] = value;
+        pattern().setStep(index, value);
     }
     bool getPatternValue(int index)
     {
-        return pattern[index];
+        return pattern().getStep(index);
     }
 
-    void setBeatPosition(float _beatPosition)
+    /*
+    The next active step after the given step (wrapping round), or -1 if the pattern is empty.
+    */
+    int nextHitAfter(int step)
     {
-        beatPosition = _beatPosition;
+        return pattern().nextHitAfter(step);
     }
 
-    void setPrevIndex(int _prevIndex)
+    int getPatternSize()
     {
-        prevIndex = _prevIndex;
+        return patternSize();
     }
 
     int getMidiValue()
     {
-        return midiValue;
+        return midiValue();
     }
 
     void setMidiValue(int _midiValue)
     {
-        midiValue = _midiValue;
+        midiValue() = _midiValue;
     }
 
     int getMidiVelocity()
     {
-        return midiVelocity;
+        return midiVelocity();
     }
 
     void setMidiVelocity(int _midiVelocity)
     {
-        midiVelocity = _midiVelocity;
+        midiVelocity() = _midiVelocity;
+    }
+
+    int getGateLength()
+    {
+        return gateLength();
+    }
+
+    void setGateLength(int _gateLength)
+    {
+        gateLength() = juce::jmax(1, _gateLength);
     }
 
     int getNumBeats()
     {
-        return numBeats;
+        return numBeats();
     }
 
     int getNumBeatDivisions()
     {
-        return numBeatDivisions;
+        return numBeatDivisions();
     }
 
 private:
-    int prevIndex;
-    int numBeats;
-    int numBeatDivisions;
-    int patternSize;
-
-    std::vector<bool> pattern;
-
-    float beatPosition;
-    
-    int midiValue;
-    int midiVelocity;
+    SequenceFields* fields;
+    int slot;
+
+    // this Sequence's entry in each of the bank's arrays
+    int& numBeats() { return fields->numBeats[slot]; }
+    int& numBeatDivisions() { return fields->numBeatDivisions[slot]; }
+    int& scheduledStep() { return fields->scheduledSteps[slot]; }
+    juce::uint32& randomState() { return fields->randomStates[slot]; }
+    int& patternSize() { return fields->patternSizes[slot]; }
+    StepPattern& pattern() { return fields->patterns[slot]; }
+    int& midiValue() { return fields->midiValues[slot]; }
+    int& midiVelocity() { return fields->midiVelocities[slot]; }
+    int& gateLength() { return fields->gateLengths[slot]; } // <- in ticks
 
     // =============================
     // some private helper functions
 
-    static bool isNumber(juce::String inputText)
+    juce::int64 stepStartTick(juce::int64 step)
     {
-        if (inputText.length() > 0)
-        {
-            bool isNumber = true;
-            for (int i = 0; i < inputText.length(); i++)
-            {
-                isNumber = isNumber && std::isdigit(inputText[i]);
-            }
-            return isNumber;
-        }
-        else return false;
+        return -Transport::floorDiv(-step * Transport::ticksPerBeat, numBeatDivisions());
     }
 
-    static int stringToInt(juce::String inputText)
+    /*
+    When an (absolute) step actually plays: its start tick plus its micro-timing
+    offset, with the offset limited to under half a step either way.
+    */
+    juce::int64 stepHitTick(juce::int64 step)
     {
-        return std::stoi(inputText.toStdString());
+        int maxOffset = juce::jmax(0, (Transport::ticksPerBeat / numBeatDivisions()) / 2 - 1);
+        int offset = juce::jlimit(-maxOffset, maxOffset, (int)pattern().getStepOffset((int)Transport::floorMod(step, patternSize())));
+        return stepStartTick(step) + offset;
     }
 
-    void resizePatternVector(int newSize)
+    /*
+    The next absolute step after the given absolute step which has a hit (the pattern must not be empty).
+    */
+    juce::int64 nextHitStepAfter(juce::int64 step)
     {
-        if (newSize > patternSize)
-        {
-            // size increased: add on some extra elements to the pattern vector
-            for (int i = patternSize; i < numBeats * numBeatDivisions; i++)
-            {
-                pattern.push_back(false);
-            }
-        }
-        else if (newSize < patternSize)
-        {
-            // size decreased: remove some elements of pattern vector
-            pattern.resize(newSize);
-        }
+        int index = (int)Transport::floorMod(step, patternSize());
+        int nextIndex = pattern().nextHitAfter(index);
+
+        juce::int64 nextStep = (step - index) + nextIndex;
+        if (nextIndex <= index) nextStep += patternSize(); // <- wrapped round into the next loop
+        return nextStep;
+    }
 
-        patternSize = newSize;
+    /*
+    A tiny xorshift random number generator, so each Sequence has its own cheap random numbers.
+    */
+    juce::uint32 nextRandom()
+    {
+        randomState() ^= randomState() << 13;
+        randomState() ^= randomState() >> 17;
+        randomState() ^= randomState() << 5;
+        return randomState();
     }
 };
\ No newline at end of file
@@ -0,0 +1,204 @@
+/*
+  ==============================================================================
+
+    SequenceBank.h
+    Created: 18 Oct 2026 3:02:48pm
+    Author:  User
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+#include <memory>
+#include "Sequence.h"
+
+/*
+A SequenceBank holds all of the plugin's Sequences in a fixed number of 'slots', allocated once in
+prepare(). Their data is kept field by field - patterns, midi notes, velocities, lengths and so on each
+in their own contiguous array (see SequenceFields) - and each Sequence object is just a handle onto its
+slot in those arrays. So iterating over the bank walks through memory in order rather than chasing
+pointers to objects scattered around the heap, and a pass over one field (e.g. every sequence's midi
+note) doesn't drag the big patterns through the cache with it. (Each sequence's state is in the same
+kind of slot-indexed array, in the StateHandler.)
+
+Sequences are added and removed from the message thread by claiming / releasing slots,
+which never allocates. Slot indices stay the same for the lifetime of a sequence (the
+TransitionRule objects refer to sequences by index), so removing leaves a gap which the
+next addSequence() call will reuse.
+
+Removal is two-step: removeSequence() only marks the slot as pending, and the audio thread
+(StateHandler::updateSequences) finishes it off by calling finishRemoval() for that slot once
+it has turned the sequence off - so the audio thread never sees a slot change underneath it.
+*/
+class SequenceBank
+{
+public:
+
+    /// <summary>
+    /// Allocate the slots. Call this from prepareToPlay / the message thread, not the audio thread.
+    /// Any sequences already in the bank are cleared.
+    /// </summary>
+    /// <param name="_capacity"> the maximum number of sequences the bank can hold.</param>
+    void prepare(int _capacity)
+    {
+        capacity = _capacity;
+        fields.allocate(capacity);
+        sequences.clear();
+        sequences.reserve(capacity);
+        for (int i = 0; i < capacity; i++) sequences.emplace_back(&fields, i);
+        inUse = std::make_unique<std::atomic<bool>[]>(capacity);
+        pendingRemoval = std::make_unique<std::atomic<bool>[]>(capacity);
+        for (int i = 0; i < capacity; i++)
+        {
+            inUse[i] = false;
+            pendingRemoval[i] = false;
+        }
+        numSlotsUsed = 0;
+        numPendingRemovals = 0;
+    }
+
+    /// <summary>
+    /// Claim a free slot for a new Sequence and initialize it (message thread only).
+    /// </summary>
+    /// <param name="_midiValue"> the midi value the Sequence will output.</param>
+    /// <param name="_midiVelocity"> the midi velocity the Sequence will output.</param>
+    /// <param name="_numBeats"> the total number of beats in the Sequence.</param>
+    /// <param name="_numBeatDivisions"> the total number of sub-divisions each beat has.</param>
+    /// <returns> the slot index of the new Sequence, or -1 if the bank is full (or the length doesn't fit in a StepPattern).</returns>
+    int addSequence(int _midiValue, int _midiVelocity, int _numBeats, int _numBeatDivisions)
+    {
+        if (!StepPattern::isValidLength(_numBeats, _numBeatDivisions)) return -1;
+
+        for (int i = 0; i < capacity; i++)
+        {
+            if (!inUse[i] && !pendingRemoval[i])
+            {
+                // the audio thread ignores slots which aren't in use, so it's
+                // safe to set this one up before publishing it below
+                sequences[i].initialize(_midiValue, _midiVelocity, _numBeats, _numBeatDivisions);
+                inUse[i].store(true, std::memory_order_release);
+
+                if (i + 1 > numSlotsUsed) numSlotsUsed = i + 1;
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    /*
+    As addSequence(), but into a particular slot (e.g. when restoring a saved state, so the
+    TransitionRule objects' indices still match). Returns false if the slot isn't free (or the length doesn't fit).
+    */
+    bool addSequenceAt(int index, int _midiValue, int _midiVelocity, int _numBeats, int _numBeatDivisions)
+    {
+        if (index < 0 || index >= capacity || inUse[index] || pendingRemoval[index]) return false;
+        if (!StepPattern::isValidLength(_numBeats, _numBeatDivisions)) return false;
+
+        sequences[index].initialize(_midiValue, _midiVelocity, _numBeats, _numBeatDivisions);
+        inUse[index].store(true, std::memory_order_release);
+
+        if (index + 1 > numSlotsUsed) numSlotsUsed = index + 1;
+        return true;
+    }
+
+    /*
+    Free every slot straight away. Only for when the audio thread can't be using the bank
+    (before it's started processing, or while processing is suspended).
+    */
+    void releaseAll()
+    {
+        for (int i = 0; i < capacity; i++)
+        {
+            inUse[i] = false;
+            pendingRemoval[i] = false;
+        }
+        numSlotsUsed = 0;
+        numPendingRemovals = 0;
+    }
+
+    /*
+    Ask for a Sequence to be removed (message thread only). The slot isn't actually
+    freed until the audio thread calls finishRemoval() for it.
+    */
+    void removeSequence(int index)
+    {
+        if (index < 0 || index >= capacity || !inUse[index]) return;
+        if (pendingRemoval[index]) return; // <- already asked for (it's only counted once)
+
+        pendingRemoval[index].store(true, std::memory_order_release);
+        numPendingRemovals += 1;
+    }
+
+    bool hasPendingRemovals()
+    {
+        return numPendingRemovals.load(std::memory_order_acquire) > 0;
+    }
+
+    bool isPendingRemoval(int index)
+    {
+        return pendingRemoval[index].load(std::memory_order_acquire);
+    }
+
+    /*
+    Free a slot marked by removeSequence(). Called by the audio thread once it has
+    stopped using the sequence.
+    */
+    void finishRemoval(int index)
+    {
+        inUse[index].store(false, std::memory_order_release);
+        pendingRemoval[index].store(false, std::memory_order_release);
+        numPendingRemovals -= 1;
+    }
+
+    // =========================
+    // some getters:
+
+    bool isInUse(int index)
+    {
+        return inUse[index].load(std::memory_order_acquire);
+    }
+
+    int getCapacity()
+    {
+        return capacity;
+    }
+
+    /*
+    One past the highest slot index that has been used, i.e. the range of
+    indices worth looping over (slots in this range may still be empty).
+    */
+    int getNumSlotsUsed()
+    {
+        return numSlotsUsed.load(std::memory_order_acquire);
+    }
+
+    /*
+    The number of slots actually holding a Sequence.
+    */
+    int getNumSequences()
+    {
+        int numSequences = 0;
+        for (int i = 0; i < getNumSlotsUsed(); i++)
+        {
+            if (isInUse(i)) numSequences += 1;
+        }
+        return numSequences;
+    }
+
+    Sequence* getSequencePtr(int index)
+    {
+        return &sequences[index];
+    }
+
+private:
+    int capacity = 0;
+    SequenceFields fields;
+    std::vector<Sequence> sequences; // <- a handle onto each slot of fields
+    std::unique_ptr<std::atomic<bool>[]> inUse;
+    std::unique_ptr<std::atomic<bool>[]> pendingRemoval;
+    std::atomic<int> numSlotsUsed { 0 };
+    std::atomic<int> numPendingRemovals { 0 };
+};
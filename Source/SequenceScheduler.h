@@ -0,0 +1,166 @@
+/*
+  ==============================================================================
+
+    SequenceScheduler.h
+    Created: 18 Oct 2026 1:15:37pm
+    Author:  User
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+
+/*
+A SequenceScheduler keeps every active Sequence in a binary min-heap, keyed on the
+tick position of that Sequence's next hit. Each block, the StateHandler only pops the
+entries which are due (next hit <= current tick) - so sequences which don't have a note
+in this block aren't touched at all.
+
+Storage is allocated in setCapacity() (as sequences are added), after which scheduling /
+removing never allocates (so it's fine to use on the audio thread).
+*/
+class SequenceScheduler
+{
+public:
+
+    // the tick value used for 'never' (e.g. a Sequence with an empty pattern)
+    static constexpr juce::int64 never = INT64_MAX;
+
+    /// <summary>
+    /// Allocate space for a number of sequences (anything already scheduled stays scheduled).
+    /// Call this from prepareToPlay / the message thread, not the audio thread.
+    /// </summary>
+    /// <param name="maxNumSequences"> the maximum sequence index + 1 that will be scheduled.</param>
+    void setCapacity(int maxNumSequences)
+    {
+        heap.reserve(maxNumSequences);
+        if (maxNumSequences > (int)heapPositions.size()) heapPositions.resize(maxNumSequences, -1);
+    }
+
+    /// <summary>
+    /// Schedule a sequence's next hit, or move it if it's already scheduled.
+    /// </summary>
+    /// <param name="seqIdx"> the index of the Sequence.</param>
+    /// <param name="tick"> the tick position of its next hit (or 'never' to just remove it).</param>
+    void schedule(int seqIdx, juce::int64 tick)
+    {
+        if (tick == never)
+        {
+            remove(seqIdx);
+            return;
+        }
+
+        int pos = heapPositions[seqIdx];
+        if (pos < 0)
+        {
+            pos = (int)heap.size();
+            heap.push_back({ tick, seqIdx });
+            heapPositions[seqIdx] = pos;
+            siftUp(pos);
+        }
+        else
+        {
+            juce::int64 oldTick = heap[pos].tick;
+            heap[pos].tick = tick;
+            if (tick < oldTick) siftUp(pos);
+            else siftDown(pos);
+        }
+    }
+
+    /*
+    Stop scheduling a sequence (does nothing if it isn't scheduled).
+    */
+    void remove(int seqIdx)
+    {
+        int pos = heapPositions[seqIdx];
+        if (pos < 0) return;
+
+        int last = (int)heap.size() - 1;
+        if (pos != last)
+        {
+            swapEntries(pos, last);
+        }
+        heap.pop_back();
+        heapPositions[seqIdx] = -1;
+
+        if (pos < (int)heap.size())
+        {
+            siftUp(pos);
+            siftDown(pos);
+        }
+    }
+
+    bool isScheduled(int seqIdx)
+    {
+        return heapPositions[seqIdx] >= 0;
+    }
+
+    /*
+    Is the earliest scheduled hit at or before the given tick?
+    */
+    bool hasHitDueBy(juce::int64 tick)
+    {
+        return !heap.empty() && heap[0].tick <= tick;
+    }
+
+    /*
+    The sequence with the earliest scheduled hit (only valid if something is scheduled).
+    */
+    int getNextSequence()
+    {
+        return heap[0].seqIdx;
+    }
+
+    juce::int64 getNextTick()
+    {
+        return heap.empty() ? never : heap[0].tick;
+    }
+
+private:
+
+    struct Entry
+    {
+        juce::int64 tick;
+        int seqIdx;
+    };
+
+    std::vector<Entry> heap;
+    std::vector<int> heapPositions; // <- where each sequence is in the heap (-1 if not scheduled)
+
+    void swapEntries(int a, int b)
+    {
+        std::swap(heap[a], heap[b]);
+        heapPositions[heap[a].seqIdx] = a;
+        heapPositions[heap[b].seqIdx] = b;
+    }
+
+    void siftUp(int pos)
+    {
+        while (pos > 0)
+        {
+            int parent = (pos - 1) / 2;
+            if (heap[parent].tick <= heap[pos].tick) break;
+            swapEntries(parent, pos);
+            pos = parent;
+        }
+    }
+
+    void siftDown(int pos)
+    {
+        int size = (int)heap.size();
+        while (true)
+        {
+            int smallest = pos;
+            int left = (2 * pos) + 1;
+            int right = left + 1;
+            if (left < size && heap[left].tick < heap[smallest].tick) smallest = left;
+            if (right < size && heap[right].tick < heap[smallest].tick) smallest = right;
+            if (smallest == pos) break;
+            swapEntries(smallest, pos);
+            pos = smallest;
+        }
+    }
+};
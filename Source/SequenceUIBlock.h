@@ -13,6 +13,7 @@
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "StepGridView.h"
 
 class SequenceUIBlock : public juce::Component
 {
@@ -27,37 +28,35 @@ public:
     SequenceUIBlock(Assignment3AudioProcessor* _audioProcessor, int _seqIdx)
     {
         audioProcessor = _audioProcessor;
-        seqIdx = _seqIdx;
 
         patternInputLabel.setText("Pattern", juce::dontSendNotification);
         patternInputLabel.attachToComponent(&patternInput, true);
-        patternInput.onTextChange = [this] {audioProcessor->stateHandler.getSequencePtr(seqIdx)->setPatternFromString(patternInput.getText()); };
+        patternInput.onTextChange = [this] { sendPattern(); };
 
         numBeatsLabel.setText("Beats/divs", juce::dontSendNotification);
         numBeatsLabel.attachToComponent(&textNumBeats, true);
-        textNumBeats.onTextChange = [this] {audioProcessor->stateHandler.getSequencePtr(seqIdx)->setNumBeatsFromString(textNumBeats.getText()),
-            audioProcessor->stateHandler.getSequencePtr(seqIdx)->setPatternFromString(patternInput.getText()); };
+        textNumBeats.onTextChange = [this] { sendPattern(); };
 
-        textNumSubBeats.onTextChange = [this] {audioProcessor->stateHandler.getSequencePtr(seqIdx)->setNumBeatDivisionsFromString(textNumSubBeats.getText()),
-            audioProcessor->stateHandler.getSequencePtr(seqIdx)->setPatternFromString(patternInput.getText()); };
+        textNumSubBeats.onTextChange = [this] { sendPattern(); };
         
         midiNoteLabel.setText("note", juce::dontSendNotification);
         midiNoteLabel.attachToComponent(&textMidiNote, true);
-        textMidiNote.onTextChange = [this] {audioProcessor->stateHandler.getSequencePtr(seqIdx)->setMidiValueFromString(textMidiNote.getText()); };
-        textMidiNote.setText((juce::String)audioProcessor->stateHandler.getSequencePtr(seqIdx)->getMidiValue(), juce::dontSendNotification);
+        textMidiNote.onTextChange = [this] { sendNumber(EditCommand::setMidiValue, textMidiNote.getText()); };
 
 
         midiVelocityLabel.setText("vel", juce::dontSendNotification);
         midiVelocityLabel.attachToComponent(&textMidiVelocity, true);
-        textMidiVelocity.onTextChange = [this] {audioProcessor->stateHandler.getSequencePtr(seqIdx)->setMidiVelocityFromString(textMidiVelocity.getText()); };
-        textMidiVelocity.setText((juce::String) audioProcessor->stateHandler.getSequencePtr(seqIdx)->getMidiVelocity(), juce::dontSendNotification);
+        textMidiVelocity.onTextChange = [this] { sendNumber(EditCommand::setMidiVelocity, textMidiVelocity.getText()); };
 
+        gateLabel.setText("gate", juce::dontSendNotification);
+        gateLabel.attachToComponent(&textGate, true);
+        textGate.onTextChange = [this] { sendNumber(EditCommand::setGateLength, textGate.getText()); };
         
-        updateColour();
+        setOpaque(true); // <- paint() fills the whole block, so nothing behind it needs repainting
 
         // initialize the patterns and other vals to data from 
         // initialized StateHandler / sequence objects.
-        setTextFromSequence();     
+        setSequenceIndex(_seqIdx);
 
         addAndMakeVisible(patternInput);
         addAndMakeVisible(patternInputLabel);
@@ -72,36 +71,115 @@ public:
 
         addAndMakeVisible(textMidiVelocity);
         addAndMakeVisible(midiVelocityLabel);
+
+        addAndMakeVisible(textGate);
+        addAndMakeVisible(gateLabel);
+
+        addAndMakeVisible(stepGrid);
     }
     /*
-    Update the background colour to whatever the appropriate colour is for the current Sequence state stored in StateHandler.
-    I.e. for animating the traffic-light colours.
+    Update the background colour to whatever the appropriate colour is for the Sequence's current state
+    (from the latest TelemetryFrame). I.e. for animating the traffic-light colours.
+    Only repaints if the colour's actually changed (this is called at the editor's frame rate).
     */
-    void updateColour()
+    void updateColour(StateHandler::State state)
     {
-        backgroundColour = audioProcessor->stateHandler.getStateColour(seqIdx);  
+        juce::Colour colour = StateHandler::getColourForState(state);
+        if (colour == backgroundColour) return;
+
+        backgroundColour = colour;
         repaint();
     }
 
+    int getSequenceIndex()
+    {
+        return seqIdx;
+    }
+
     /*
-    Used when initializing the UI to what was initialized in the Assignment3AudioProcessor.
+    Point this block at a different Sequence (the editor's list recycles blocks as it scrolls),
+    showing that Sequence's values and state.
     */
-    void setTextFromSequence()
+    void setSequenceIndex(int _seqIdx)
+    {
+        seqIdx = _seqIdx;
+        setTextFromSequence();
+
+        backgroundColour = juce::Colours::transparentBlack;
+        updateColour(audioProcessor->stateHandler.getState(seqIdx));
+    }
+
+    /*
+    Send the pattern, number of beats and beat divisions currently typed in to the audio
+    thread, as one edit. Nothing is sent if the beats / divisions aren't numbers or make a length
+    that doesn't fit in a StepPattern, or if the pattern's invalid - whichever's wrong is shown
+    in red until it's fixed.
+    */
+    void sendPattern()
     {
-        juce::String patternString = "";
-        std::vector<bool>* pattern = audioProcessor->stateHandler.getSequencePtr(seqIdx)->getPatternPtr();
-        for (bool p : *pattern)
+        // the length has to fit in a StepPattern (at least 1 x 1, at most StepPattern::maxNumSteps steps)
+        int numBeats, numBeatDivisions;
+        bool validLength = PatternParser::parseNumber(textNumBeats.getText(), numBeats)
+            && PatternParser::parseNumber(textNumSubBeats.getText(), numBeatDivisions)
+            && StepPattern::isValidLength(numBeats, numBeatDivisions);
+        textNumBeats.applyColourToAllText(validLength ? juce::Colours::white : juce::Colours::red);
+        textNumSubBeats.applyColourToAllText(validLength ? juce::Colours::white : juce::Colours::red);
+
+        if (validLength)
         {
-            if (p) patternString += 1;
-            else patternString += 0;
+            bool valid = PatternParser::isValid(patternInput.getText());
+            patternInput.applyColourToAllText(valid ? juce::Colours::white : juce::Colours::red);
+            if (valid)
+            {
+                audioProcessor->stateHandler.pushPatternEdit(seqIdx, numBeats, numBeatDivisions, patternInput.getText());
+
+                // show the new pattern straight away (the same way the edit builds it)
+                typedPattern.clear();
+                typedPattern.setSize(numBeats * numBeatDivisions);
+                PatternParser::parse(patternInput.getText(), typedPattern);
+                stepGrid.setPattern(typedPattern, numBeats, numBeatDivisions);
+            }
         }
-        patternInput.setText(patternString);
+    }
 
-        juce::String numBeatsString = (juce::String) audioProcessor->stateHandler.getSequencePtr(seqIdx)->getNumBeats();
-        textNumBeats.setText(numBeatsString);
+    /*
+    Send a midi value / velocity / gate length typed in to the audio thread (if it's a number).
+    */
+    void sendNumber(EditCommand::Type type, juce::String text)
+    {
+        int value;
+        if (PatternParser::parseNumber(text, value))
+        {
+            audioProcessor->stateHandler.pushEdit({ type, seqIdx, value, 0, 0.0f });
+        }
+    }
+
+    /*
+    Used when initializing the UI to what was initialized in the Assignment3AudioProcessor.
+    (without sending text-change messages - these are the Sequence's values already, not edits)
+    */
+    void setTextFromSequence()
+    {
+        Sequence* sequence = audioProcessor->stateHandler.getSequencePtr(seqIdx);
+
+        patternInput.setText(sequence->getPatternAsString(), false);
+        patternInput.applyColourToAllText(juce::Colours::white);
+        textNumBeats.setText((juce::String)sequence->getNumBeats(), false);
+        textNumSubBeats.setText((juce::String)sequence->getNumBeatDivisions(), false);
 
-        juce::String numBeatDivisionsString = (juce::String)audioProcessor->stateHandler.getSequencePtr(seqIdx)->getNumBeatDivisions();
-        textNumSubBeats.setText(numBeatDivisionsString);
+        textMidiNote.setText((juce::String)sequence->getMidiValue(), false);
+        textMidiVelocity.setText((juce::String)sequence->getMidiVelocity(), false);
+        textGate.setText((juce::String)sequence->getGateLength(), false);
+
+        stepGrid.setPattern(*sequence->getPatternPtr(), sequence->getNumBeats(), sequence->getNumBeatDivisions());
+    }
+
+    /*
+    Move the step grid's playhead (from the latest TelemetryFrame's beat position).
+    */
+    void updatePlayhead(float beatPosition)
+    {
+        stepGrid.setBeatPosition(beatPosition);
     }
 
     ~SequenceUIBlock()
@@ -121,12 +199,15 @@ public:
     */
     void resized() override
     {
-        patternInput.setBounds(getLocalBounds().removeFromTop(20));
+        patternInput.setBounds(getLocalBounds().removeFromTop(20).withTrimmedRight(80));
+        textGate.setBounds(getLocalBounds().removeFromTop(20).removeFromRight(45));
         textNumBeats.setBounds(getLocalBounds().removeFromBottom(20).removeFromLeft(110).removeFromRight(30));
         textNumSubBeats.setBounds(getLocalBounds().removeFromBottom(20).removeFromLeft(140).removeFromRight(30));
 
         textMidiNote.setBounds(getLocalBounds().removeFromBottom(20).removeFromRight(130).removeFromLeft(50));
         textMidiVelocity.setBounds(getLocalBounds().removeFromBottom(20).removeFromRight(50).removeFromLeft(50));
+
+        stepGrid.setBounds(getLocalBounds().withTrimmedTop(22).withTrimmedBottom(22).reduced(5, 0));
     }
 
 private:
@@ -134,7 +215,7 @@ private:
     int seqIdx;
 
 
-    juce::Colour backgroundColour;
+    juce::Colour backgroundColour = juce::Colours::transparentBlack; // <- (never a state's colour, so the first update paints)
 
     juce::Label patternInputLabel;
     juce::TextEditor patternInput;
@@ -150,6 +231,12 @@ private:
     juce::Label midiVelocityLabel;
     juce::TextEditor textMidiVelocity;
 
+    juce::Label gateLabel;
+    juce::TextEditor textGate;
+
+    StepGridView stepGrid;
+    StepPattern typedPattern; // <- what's typed in, parsed for the step grid
+
     //==============================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SequenceUIBlock)
     
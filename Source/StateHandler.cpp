@@ -20,15 +20,27 @@
 #include "StateHandler.h"
 
 
-void StateHandler::initialize(float _sampleRate, float _tempo, EventDetector* _eventDetector)
+void StateHandler::initialize(float _sampleRate, float _tempo, EventDetector* _eventDetector, int maxNumSequences)
 {
     sampleRate = _sampleRate;
     tempo = _tempo;
     eventDetector = _eventDetector;
 
-    beatsPerSample = tempo / (60.0f * sampleRate);
-    beatPosition = 0.0f;
-    numSequences = 0;
+    transport.initialize(sampleRate, tempo);
+
+    // the grid the EventDetector and tempo adaptation read from
+    beatGrid.useSubdivision(eventDetector->getNumEventSubBeats());
+    beatGrid.useSubdivision(subBeatsConsidered);
+    beatGrid.useSubdivision(1); // <- whole beats, for the editor's beat lines
+    eventDetector->setBeatGrid(&beatGrid);
+
+    // allocate everything for the sequences here, so adding / removing them later never allocates
+    sequenceBank.prepare(maxNumSequences);
+    states.assign(maxNumSequences, State::off);
+    transitionTicks.assign(maxNumSequences, 0);
+    scheduler.setCapacity(maxNumSequences);
+    dueHits.resize(maxNumSequences);
+    numTransitioning = 0;
     numTransitionRules = 0;
 }
 
@@ -36,25 +48,62 @@ void StateHandler::initialize(float _sampleRate, float _tempo, EventDetector* _e
 void StateHandler::setSampleRate(float _sampleRate)
 {
     sampleRate = _sampleRate;
-    beatsPerSample = tempo / (60.0f * sampleRate);
+    transport.setSampleRate(sampleRate);
 }
 
 
 void StateHandler::setState(int index, State state)
 {
-    states[index] = state;
+    // from just before the current position (the scheduling searches strictly after it), as
+    // resetSequences() does - so a sequence switched on at tick 0 still plays its step 0
+    changeState(index, state, getSequencingTickPosition() - 1);
+}
+
+void StateHandler::changeState(int index, State newState, juce::int64 fromTick)
+{
+    State oldState = states[index];
+    if (oldState == newState) return;
+    states[index] = newState;
+
+    if (isTransitioningState(oldState)) numTransitioning -= 1;
+    if (isTransitioningState(newState)) numTransitioning += 1;
+
+    // (going straight from turningOn to turningOff or back keeps the boundary already worked out)
+    if (isTransitioningState(newState) && !isTransitioningState(oldState))
+    {
+        transitionTicks[index] = nextTransitionTick(index, fromTick);
+    }
+
+    if (isOutputtingState(newState) && !isOutputtingState(oldState))
+    {
+        scheduler.schedule(index, sequenceBank.getSequencePtr(index)->scheduleNextHit(fromTick));
+    }
+    else if (!isOutputtingState(newState) && isOutputtingState(oldState))
+    {
+        scheduler.remove(index);
+    }
 }
 
 
 juce::Colour StateHandler::getStateColour(int index)
 {
-    if (states[index] == State::off) return juce::Colours::red;
-    else if (states[index] == State::on) return juce::Colours::green;
-    else if (states[index] == State::turningOff) return juce::Colours::orange;
-    else if (states[index] == State::turningOn) return juce::Colours::orange;
+    return getColourForState(states[index]);
+}
+
+juce::Colour StateHandler::getColourForState(State state)
+{
+    if (state == State::off) return juce::Colours::red;
+    else if (state == State::on) return juce::Colours::green;
+    else if (state == State::turningOff) return juce::Colours::orange;
+    else if (state == State::turningOn) return juce::Colours::orange;
     else return juce::Colours::black; // <- an 'error' colour... should never happen.
 }
 
+StateHandler::State StateHandler::getState(int index)
+{
+    return states[index];
+}
+
 
 // ======================================================================
 // a load of getters and setters for handling rhythmic event midi outputs
@@ -125,11 +174,29 @@ void StateHandler::setEventReleaseMidiValueOn(int index, bool on)
 // =======================================================================
 
 
-void StateHandler::addSequence(Sequence* sequencePtr)
+int StateHandler::addSequence(int midiValue, int midiVelocity, int numBeats, int numBeatDivisions)
+{
+    // (a free slot's state is always off - removals turn it off before freeing it)
+    return sequenceBank.addSequence(midiValue, midiVelocity, numBeats, numBeatDivisions);
+}
+
+bool StateHandler::restoreSequence(int index, int midiValue, int midiVelocity, int numBeats, int numBeatDivisions)
+{
+    return sequenceBank.addSequenceAt(index, midiValue, midiVelocity, numBeats, numBeatDivisions);
+}
+
+void StateHandler::clearSequences()
 {
-    sequences.push_back(sequencePtr);
-    states.push_back(State::off);
-    numSequences += 1;
+    for (int i = 0; i < sequenceBank.getNumSlotsUsed(); i++)
+    {
+        changeState(i, State::off, getSequencingTickPosition());
+    }
+    sequenceBank.releaseAll();
+}
+
+void StateHandler::removeSequence(int index)
+{
+    sequenceBank.removeSequence(index);
 }
 
 void StateHandler::addTransitionRule(TransitionRule* transitionRulePtr)
@@ -143,34 +210,68 @@ EventDetector* StateHandler::getEventDetectorPtr()
     return eventDetector;
 }
 
+void StateHandler::setAnalysisWorker(AnalysisWorker* _analysisWorker)
+{
+    analysisWorker = _analysisWorker;
+}
+
+void StateHandler::updateAnalysis()
+{
+    if (analysisWorker != nullptr) analysisWorker->updateLatest();
+}
+
+float StateHandler::getAnalysisFeature(int feature)
+{
+    if (analysisWorker == nullptr) return 0.0f;
+    return analysisWorker->getFeature(feature);
+}
+
+float StateHandler::getAnalysisFeatureAge(int feature)
+{
+    if (analysisWorker == nullptr) return 1.0e9f;
+    return analysisWorker->getFeatureAge(feature);
+}
+
 void StateHandler::applyEffect(int i, TransitionRule::Effect effect)
 {
+    if (!sequenceBank.isInUse(i) || sequenceBank.isPendingRemoval(i)) return;
+
     if ((states[i] == State::off || states[i] == State::turningOff) && effect == TransitionRule::Effect::turnOn)
     {
-        states[i] = State::turningOn;
+        setState(i, State::turningOn);
     }
     else if ((states[i] == State::on || states[i] == State::turningOn) && effect == TransitionRule::Effect::turnOff)
     {
-        states[i] = State::turningOff;
+        setState(i, State::turningOff);
     }
 }
 
 void StateHandler::undoEffect(int i, TransitionRule::Effect effect)
 {
+    if (!sequenceBank.isInUse(i) || sequenceBank.isPendingRemoval(i)) return;
+
     if ((states[i] == State::off || states[i] == State::turningOff) && effect == TransitionRule::Effect::turnOff)
     {
         // state is off or turning off, and effect was turnOff, so turn on to undo the effect:
-        states[i] = State::turningOn;
+        setState(i, State::turningOn);
     }
     else if ((states[i] == State::on || states[i] == State::turningOn) && effect == TransitionRule::Effect::turnOn)
     {
         // state is on or turning on, and effect was turnOn so turn off to undo the effect:
-        states[i] = State::turningOff;
+        setState(i, State::turningOff);
     }
 }
 
+void StateHandler::setRuleEvaluationInterval(int interval)
+{
+    ruleEvaluationInterval = juce::jmax(1, interval);
+}
+
 void StateHandler::updateState()
 {
+    if (--blocksUntilRuleEvaluation > 0) return;
+    blocksUntilRuleEvaluation = ruleEvaluationInterval;
+
     for (TransitionRule* transition : transitionRules)
     {
         if (transition->triggered())
@@ -196,27 +297,238 @@ void StateHandler::updateState()
     }
 }
 
+void StateHandler::syncToHost(juce::AudioPlayHead* playHead)
+{
+    if (!hostSyncing || playHead == nullptr) return;
+
+    auto position = playHead->getPosition();
+    if (!position.hasValue()) return;
+
+    if (auto bpm = position->getBpm()) setTempo((float)*bpm);
+    if (auto timeSignature = position->getTimeSignature()) transport.setTimeSignature(timeSignature->numerator, timeSignature->denominator);
+
+    bool playing = position->getIsPlaying();
+
+    if (auto ppqPosition = position->getPpqPosition())
+    {
+        // where we'd expect to be if the host just kept on playing from the last block
+        juce::int64 expectedTick = transport.getTickPosition();
+        juce::int64 hostTick = (juce::int64) std::llround(*ppqPosition * Transport::ticksPerBeat);
+        juce::int64 drift = (hostTick > expectedTick) ? (hostTick - expectedTick) : (expectedTick - hostTick);
+
+        transport.setPpqPosition(*ppqPosition);
+
+        // host started playing, or jumped (loop / relocate) -> start sequences again from here
+        if ((playing && !hostPlaying) || drift > hostRelocationThreshold) resetSequences();
+    }
+
+    hostPlaying = playing;
+}
+
+bool StateHandler::isHostSyncing()
+{
+    return hostSyncing;
+}
+
+void StateHandler::setHostSyncing(bool _hostSyncing)
+{
+    hostSyncing = _hostSyncing;
+}
+
+StateHandler::TransitionQuantum StateHandler::getTransitionQuantum()
+{
+    return transitionQuantum;
+}
+
+void StateHandler::setTransitionQuantum(TransitionQuantum _transitionQuantum)
+{
+    transitionQuantum = _transitionQuantum;
+}
+
+juce::int64 StateHandler::nextTransitionTick(int index, juce::int64 tick)
+{
+    Sequence* sequence = sequenceBank.getSequencePtr(index);
+
+    juce::int64 quantumInTicks = 0;
+    switch (transitionQuantum)
+    {
+    case TransitionQuantum::immediate:
+        return tick + 1; // <- i.e. in the next block
+    case TransitionQuantum::nextStep:
+        return sequence->nextStepStartAfter(tick);
+    case TransitionQuantum::nextBeat:
+        quantumInTicks = Transport::ticksPerBeat;
+        break;
+    case TransitionQuantum::nextBar:
+        quantumInTicks = transport.getTicksPerBar();
+        break;
+    case TransitionQuantum::endOfPattern:
+        return sequence->nextLoopStartAfter(tick);
+    }
+
+    if (quantumInTicks <= 0) return tick + 1;
+    return (Transport::floorDiv(tick, quantumInTicks) + 1) * quantumInTicks;
+}
+
+bool StateHandler::isTransportRunning()
+{
+    return !hostSyncing || hostPlaying;
+}
+
+void StateHandler::resetSequences()
+{
+    // reschedule from just before the (new) current position,
+    // so a hit exactly where the host jumped to still plays
+    for (int i = 0; i < sequenceBank.getNumSlotsUsed(); i++)
+    {
+        if (isOutputtingState(states[i])) rescheduleSequence(i);
+
+        // and any pending transition switches at the next boundary from here instead
+        if (isTransitioningState(states[i])) transitionTicks[i] = nextTransitionTick(i, getSequencingTickPosition() - 1);
+    }
+}
+
+void StateHandler::rescheduleSequence(int index)
+{
+    if (isOutputtingState(states[index]))
+    {
+        scheduler.schedule(index, sequenceBank.getSequencePtr(index)->scheduleNextHit(getSequencingTickPosition() - 1));
+    }
+}
+
 void StateHandler::updateSequences(int numSamples)
 {
-    float beatsInBlock = (numSamples * beatsPerSample);
-    beatPosition = fmod(beatPosition + beatsInBlock, maxNumBeats);
+    // don't move if the host transport is stopped
+    transport.advance(isTransportRunning() ? numSamples : 0);
+    juce::int64 prevTickPosition = transport.getPrevTickPosition();
+
+    // sequences are scheduled up to the look-ahead position rather than the end of the block
+    juce::int64 sequencingTickPosition = getSequencingTickPosition();
+
+    beatGrid.update(transport, numSamples);
+
+    // finish off any sequences removed from the message thread: turn them off, then free the slot
+    if (sequenceBank.hasPendingRemovals())
+    {
+        for (int i = 0; i < sequenceBank.getNumSlotsUsed(); i++)
+        {
+            if (sequenceBank.isPendingRemoval(i))
+            {
+                changeState(i, State::off, prevTickPosition);
+                sequenceBank.finishRemoval(i);
+            }
+        }
+    }
+
+    // anything turning on whose boundary is in this block switches on, and gets
+    // scheduled from its boundary (so a hit right on the boundary is played)
+    for (int i = 0; i < sequenceBank.getNumSlotsUsed() && numTransitioning > 0; i++)
+    {
+        if (states[i] == State::turningOn && transitionTicks[i] <= sequencingTickPosition)
+        {
+            changeState(i, State::on, transitionTicks[i] - 1);
+        }
+    }
 
-    eventDetector->setBeatPosition(beatPosition);
-    for (int i = 0; i < numSequences; i++)
+    // now pop every sequence with a hit in this block off the scheduler
+    numDueHits = 0;
+    while (isTransportRunning() && scheduler.hasHitDueBy(sequencingTickPosition))
     {
-        if (fmod(beatPosition, sequences[i]->getNumBeats()) < beatsInBlock)
+        int i = scheduler.getNextSequence();
+        Sequence* sequence = sequenceBank.getSequencePtr(i);
+        int step = sequence->getScheduledStep();
+
+        // a sequence turning off plays right up to its boundary, but not on or after it
+        if (states[i] == State::turningOff && scheduler.getNextTick() >= transitionTicks[i])
+        {
+            changeState(i, State::off, transitionTicks[i]);
+            continue;
+        }
+
+        if (sequence->shouldTrigger(step))
         {
-            // this sequence has just looped back to this start
-            // so change any states from turningOff -> off, and turningOn -> on
-            if (states[i] == State::turningOff) states[i] = State::off;
-            if (states[i] == State::turningOn)  states[i] = State::on;
+            dueHits[numDueHits] = { i, step, scheduler.getNextTick() };
+            numDueHits += 1;
         }
 
-        // update the sequences which are currently on or still transitioning
-        if (states[i] == State::on || states[i] == State::turningOff) sequences[i]->setBeatPosition(beatPosition);
+        // one note per sequence per block: skip any other hits in this block
+        scheduler.schedule(i, sequence->scheduleNextHit(sequencingTickPosition));
+    }
+
+    // and anything else turning off whose boundary is in this block (i.e. it had no hit left before it)
+    for (int i = 0; i < sequenceBank.getNumSlotsUsed() && numTransitioning > 0; i++)
+    {
+        if (states[i] == State::turningOff && transitionTicks[i] <= sequencingTickPosition)
+        {
+            changeState(i, State::off, transitionTicks[i]);
+        }
     }
 }
 
+bool StateHandler::pushEdit(const EditCommand& command)
+{
+    return editQueue.push(command);
+}
+
+bool StateHandler::pushPatternEdit(int index, int numBeats, int numBeatDivisions, juce::String patternText)
+{
+    return editQueue.pushPattern(index, numBeats, numBeatDivisions,
+        [&patternText](StepPattern& staged) { return PatternParser::parse(patternText, staged); });
+}
+
+void StateHandler::applyEdits()
+{
+    editQueue.applyAll([this](const EditCommand& command, const StepPattern& stagedPattern) { applyEdit(command, stagedPattern); });
+}
+
+void StateHandler::applyEdit(const EditCommand& command, const StepPattern& stagedPattern)
+{
+    switch (command.type)
+    {
+    case EditCommand::setPattern:
+        getSequencePtr(command.sequence)->applyPattern(command.intValue, command.intValue2, stagedPattern);
+        rescheduleSequence(command.sequence);
+        break;
+    case EditCommand::setMidiValue:
+        getSequencePtr(command.sequence)->setMidiValue(command.intValue);
+        break;
+    case EditCommand::setMidiVelocity:
+        getSequencePtr(command.sequence)->setMidiVelocity(command.intValue);
+        break;
+    case EditCommand::setGateLength:
+        getSequencePtr(command.sequence)->setGateLength(command.intValue);
+        break;
+    case EditCommand::setTempo:
+        setTempo(command.floatValue);
+        break;
+    case EditCommand::setAdaptingTempo:
+        setAdaptingTempo(command.intValue != 0);
+        break;
+    case EditCommand::setAdaptationSpeed:
+        setAdaptationSpeed(command.floatValue);
+        break;
+    case EditCommand::setAdaptationBias:
+        setAdaptationBias(command.floatValue);
+        break;
+    case EditCommand::setHostSyncing:
+        setHostSyncing(command.intValue != 0);
+        break;
+    case EditCommand::setTransitionQuantum:
+        setTransitionQuantum((TransitionQuantum)juce::jlimit(0, (int)TransitionQuantum::endOfPattern, command.intValue));
+        break;
+    }
+}
+
+int StateHandler::getNumDueHits()
+{
+    return numDueHits;
+}
+
+StateHandler::SequenceHit StateHandler::getDueHit(int dueIndex)
+{
+    return dueHits[dueIndex];
+}
+
 
 // ===================================================================
 // some tempo stuff: getters / setters and tempo adaptation...
@@ -228,7 +540,7 @@ void StateHandler::setTempo(float _tempo)
     if (fabs(_tempo - tempo) > 0.01)
     {
         tempo = _tempo;
-        beatsPerSample = tempo / (60.0f * sampleRate);
+        transport.setTempo(tempo);
     }
 }
 
@@ -271,17 +583,13 @@ void StateHandler::setAdaptationBias(float _adaptationBias)
 
 void StateHandler::updateTempo()
 {
-    if (isAdaptingTempo())
+    // when syncing to the host, the host is in charge of tempo
+    if (isAdaptingTempo() && !hostSyncing)
     {
         if (eventDetector->getEventOccurring())
         {
-            float subBeatPosition = (fmod(beatPosition, 1.0f) * subBeatsConsidered);
-            int currentSubBeat = (int)subBeatPosition;
-            // int prevSubBeat = (currentSubBeat - 1); 
-            int nextSubBeat = (currentSubBeat + 1); // dont think we actually want to bother with mod subBeatsConsidered here
-
-            float distToCurrent = subBeatPosition - currentSubBeat;
-            float distToNext = nextSubBeat - subBeatPosition;
+            float distToCurrent = beatGrid.getSubBeatFraction(subBeatsConsidered);
+            float distToNext = 1.0f - distToCurrent;
 
             // weight the tempo updates by 1 / (1 + event density).
             // so that when events are less frequent they individually have bigger effects on the tempo change
@@ -314,21 +622,74 @@ void StateHandler::updateTempo()
 
 float StateHandler::distToBeat(int beat, int subBeat, int numBeats, int numSubBeats)
 {
-    float pos = fmod(beatPosition, numBeats);
-    return fabs(pos - (beat + (((float)subBeat) / numSubBeats)));
+    // position within the numBeats long loop, from the grid's beat / beat phase
+    juce::int64 pos = (Transport::floorMod(beatGrid.getBeat(), numBeats) * Transport::ticksPerBeat) + beatGrid.getBeatPhase();
+    juce::int64 target = ((juce::int64)beat * Transport::ticksPerBeat) + (((juce::int64)subBeat * Transport::ticksPerBeat) / numSubBeats);
+    juce::int64 dist = (pos > target) ? (pos - target) : (target - pos);
+    return (float)dist / Transport::ticksPerBeat;
 }
 
 int StateHandler::getNumSequences()
 {
-    return numSequences;
+    return sequenceBank.getNumSlotsUsed();
+}
+
+bool StateHandler::isSequenceInUse(int seqIndex)
+{
+    return sequenceBank.isInUse(seqIndex);
 }
 
 Sequence* StateHandler::getSequencePtr(int seqIndex)
 {
-    return sequences[seqIndex];
+    return sequenceBank.getSequencePtr(seqIndex);
 }
 
 float StateHandler::getBeatPosition()
 {
-    return beatPosition;
+    return (float)beatGrid.getBeatPosition();
+}
+
+const BeatGrid& StateHandler::getBeatGrid()
+{
+    return beatGrid;
+}
+
+juce::int64 StateHandler::getTickPosition()
+{
+    return transport.getTickPosition();
+}
+
+int StateHandler::getSampleOffset(juce::int64 tick, int numSamples)
+{
+    return transport.getSampleOffsetOfTick(tick, numSamples, lookAheadSamples) + outputLatencySamples;
+}
+
+void StateHandler::setOutputLatencySamples(int _outputLatencySamples)
+{
+    outputLatencySamples = juce::jmax(0, _outputLatencySamples);
+}
+
+void StateHandler::setLookAheadSamples(int _lookAheadSamples)
+{
+    lookAheadSamples = juce::jmax(0, _lookAheadSamples);
+}
+
+int StateHandler::getLookAheadSamples()
+{
+    return lookAheadSamples;
+}
+
+juce::int64 StateHandler::getSequencingTickPosition()
+{
+    return transport.getTickPositionAhead(lookAheadSamples);
+}
+
+juce::int64 StateHandler::ticksToSamples(juce::int64 ticks)
+{
+    return transport.ticksToSamples(ticks);
+}
+
+int StateHandler::getEventGateLength()
+{
+    return eventGateLength;
 }
\ No newline at end of file
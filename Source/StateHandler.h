@@ -13,13 +13,19 @@
 #include "EventDetector.h"
 #include <vector>
 #include "Sequence.h"
+#include "SequenceBank.h"
 #include "TransitionRule.h"
+#include "Transport.h"
+#include "SequenceScheduler.h"
+#include "EditQueue.h"
+#include "BeatGrid.h"
+#include "AnalysisWorker.h"
 #include <JuceHeader.h>
 
 
 /*
 A StateHandler object maintains a list of sequencesand transition rules, and at every 
-update it updates a global "beatPosition" for the sequences, and checks and
+update it advances a shared Transport (tick position) for the sequences, and checks and
 applies any effects from  the list of transition rules.
 */
 class StateHandler {
@@ -32,18 +38,36 @@ public:
     keep things readable.
     */
     enum State { turningOff = -1, off = 0, turningOn = 1, on = 2 };
+
+    /*
+    When a sequence which is turningOn / turningOff actually switches: straight away,
+    or at the next step / beat / bar line, or at the end of its pattern.
+    */
+    enum TransitionQuantum { immediate = 0, nextStep, nextBeat, nextBar, endOfPattern };
+
+    /*
+    A Sequence hit which is due in the current block: which sequence,
+    which step of its pattern, and the tick it's due at.
+    */
+    struct SequenceHit
+    {
+        int sequence;
+        int step;
+        juce::int64 tick;
+    };
     
     /// <summary>
     /// Initialize member variables of the StateHandler. For now, be careful not to call this more than once.
     /// </summary>
     /// <param name="_sampleRate"> the sample rate the plugin is using.</param>
-    /// <param name="_tempo"> the tempo of which to update the beatPosition.</param>
+    /// <param name="_tempo"> the tempo of which to advance the Transport tick position.</param>
     /// <param name="_eventDetector"> a pointer to an initialized EventDetector object.</param>
-    void initialize(float _sampleRate, float _tempo, EventDetector* _eventDetector);
+    /// <param name="maxNumSequences"> the capacity of the SequenceBank (allocated here, once).</param>
+    void initialize(float _sampleRate, float _tempo, EventDetector* _eventDetector, int maxNumSequences);
     
     /// <summary>
-    /// Updates the sampleRate variable and the beatsPerSample variable
-    /// which depends on sampleRate.
+    /// Updates the sampleRate variable (and the Transport, whose
+    /// ticks-per-sample depends on sampleRate).
     /// </summary>
     /// <param name="_sampleRate"> the new sample rate. </param>
     void setSampleRate(float _sampleRate);
@@ -62,6 +86,9 @@ public:
     /// <param name="index"> which Sequence in the StateHandler's vector.</param>
     /// <returns> the colour (red, orange or green) for on, off or turningOn/Off. </returns>
     juce::Colour getStateColour(int index);
+    static juce::Colour getColourForState(State state); // <- as above, for a state from a TelemetryFrame
+
+    State getState(int index);
 
     // ==================================
     // some getters/setters for midi stuff
@@ -83,11 +110,34 @@ public:
     // ==================================
 
     /// <summary>
-    /// Add a sequence to the StateHandler (part of the 
-    /// initialization process)
+    /// Add a sequence to the StateHandler's SequenceBank (message thread only - doesn't allocate).
+    /// The new sequence starts off.
     /// </summary>
-    /// <param name="sequencePtr"> pointer to a Sequence object.</param>
-    void addSequence(Sequence* sequencePtr);
+    /// <param name="midiValue"> the midi value the Sequence will output.</param>
+    /// <param name="midiVelocity"> the midi velocity the Sequence will output.</param>
+    /// <param name="numBeats"> the total number of beats in the Sequence.</param>
+    /// <param name="numBeatDivisions"> the total number of sub-divisions each beat has.</param>
+    /// <returns> the index of the new sequence, or -1 if the bank is full.</returns>
+    int addSequence(int midiValue, int midiVelocity, int numBeats, int numBeatDivisions);
+
+    /*
+    Put a sequence into a particular slot (see SequenceBank::addSequenceAt()) - for
+    restoring a saved state. Returns false if the slot isn't free.
+    */
+    bool restoreSequence(int index, int midiValue, int midiVelocity, int numBeats, int numBeatDivisions);
+
+    /*
+    Turn every sequence off and remove them all straight away. Only for when the audio thread
+    isn't processing (e.g. while restoring a saved state, with processing suspended).
+    */
+    void clearSequences();
+
+    /*
+    Remove a sequence (message thread only). The audio thread turns it off and frees its
+    slot on the next updateSequences() call. Any TransitionRule still referring to the
+    index just has no effect.
+    */
+    void removeSequence(int index);
 
     /// <summary>
     /// Add a TransitionRule to the StateHandler (part of 
@@ -102,6 +152,23 @@ public:
     */
     EventDetector* getEventDetectorPtr();
 
+    /*
+    The AnalysisWorker computing the slower features (see AnalysisFeatures) on its own thread.
+    */
+    void setAnalysisWorker(AnalysisWorker* _analysisWorker);
+
+    /*
+    Pick up the AnalysisWorker's newest results (audio thread, once per block, before updateState()).
+    */
+    void updateAnalysis();
+
+    /*
+    An analysis feature (an AnalysisFeatures::Feature), and how long ago (in seconds)
+    it was last updated - so rules can ignore it when it's too stale to act on.
+    */
+    float getAnalysisFeature(int feature);
+    float getAnalysisFeatureAge(int feature);
+
     /// <summary>
     /// Apply a provided effect, handling any logic, e.g. can't turnOff if state already off.
     /// </summary>
@@ -125,12 +192,84 @@ public:
     */
     void updateState();
 
+    /*
+    Only evaluate the TransitionRules every interval blocks (1 = every block) - used
+    by the processing-budget degradation to save time under load.
+    */
+    void setRuleEvaluationInterval(int interval);
+
     /// <summary>
-    /// Updates the global beatPosition variable for all the Sequence objects.
+    /// When host syncing is turned on, reads the host's position, tempo, time signature and play
+    /// state from the provided AudioPlayHead and locks the Transport to them. If the host has jumped
+    /// somewhere else (or just started playing) the Sequence objects are reset. Call this once per
+    /// block before updateSequences(). Does nothing if host syncing is off.
+    /// </summary>
+    /// <param name="playHead"> the plugin's AudioPlayHead (can be nullptr).</param>
+    void syncToHost(juce::AudioPlayHead* playHead);
+
+    bool isHostSyncing();
+    void setHostSyncing(bool _hostSyncing);
+
+    /*
+    The grid every sequence's turningOn / turningOff switches on (see TransitionQuantum).
+    A change only affects transitions started afterwards.
+    */
+    TransitionQuantum getTransitionQuantum();
+    void setTransitionQuantum(TransitionQuantum _transitionQuantum);
+
+    /*
+    False if syncing to the host and the host transport is stopped - in which case
+    the Transport doesn't move and no sequence notes should be output.
+    */
+    bool isTransportRunning();
+
+    /// <summary>
+    /// Advances the Transport by one block, passes the new tick position on to the EventDetector,
+    /// switches any sequences whose transition boundary falls in this block, and collects which
+    /// sequences have a hit in this block (see getNumDueHits() / getDueHit()).
     /// </summary>
     /// <param name="numSamples"> the number of samples the plugin is processing </param>
     void updateSequences(int numSamples);
 
+    /*
+    The sequence hits in the current block, found by the most recent updateSequences()
+    call (steps which lost their probability roll are already left out). Only these
+    need to output any midi.
+    */
+    int getNumDueHits();
+    SequenceHit getDueHit(int dueIndex);
+
+    /*
+    Call this after a Sequence has been edited (pattern, length, divisions) so
+    that its next hit gets rescheduled.
+    */
+    void rescheduleSequence(int index);
+
+    // ===========================================================
+    // edits from the UI: the message thread never changes anything the audio thread
+    // reads directly, it pushes EditCommands which get applied by applyEdits().
+
+    /*
+    Queue an edit from the UI (message thread only). Returns false if the queue is full.
+    */
+    bool pushEdit(const EditCommand& command);
+
+    /// <summary>
+    /// Queue a new pattern / length for a sequence from the UI (message thread only). The pattern
+    /// String is parsed here, on the message thread. Returns false if the pattern String is invalid
+    /// (nothing is queued) or the queue is full.
+    /// </summary>
+    /// <param name="index"> which sequence.</param>
+    /// <param name="numBeats"> the sequence's number of beats.</param>
+    /// <param name="numBeatDivisions"> the sequence's number of beat divisions.</param>
+    /// <param name="patternText"> the pattern String (see PatternParser).</param>
+    bool pushPatternEdit(int index, int numBeats, int numBeatDivisions, juce::String patternText);
+
+    /*
+    Apply all the queued edits from the UI. Called by the audio thread at the start of processBlock().
+    */
+    void applyEdits();
+
     // ===========================================================
     // some tempo stuff: getters / setters and tempo adaptation...
  
@@ -150,7 +289,7 @@ public:
     void updateTempo();
 
     /// <summary>
-    /// Computes the distance of current beatPosition to a specified beat
+    /// Computes the distance (in beats) of the current tick position to a specified beat
     /// </summary>
     /// <param name="beat"> beat number </param>
     /// <param name="subBeat"> sub beat number </param>
@@ -162,18 +301,73 @@ public:
     // ==================
     // some more getters:
 
-    int getNumSequences();
+    int getNumSequences(); // <- the range of sequence indices in use (see isSequenceInUse())
+    bool isSequenceInUse(int seqIndex);
     Sequence* getSequencePtr(int seqIndex);
     float getBeatPosition();  
 
+    /*
+    The grid for the most recent block (see BeatGrid) - read this rather than redoing beat maths.
+    */
+    const BeatGrid& getBeatGrid();
+    juce::int64 getTickPosition();
+
+    /*
+    Where in the current block (the samples covered by the most recent updateSequences()
+    call) a SequenceHit's tick should be output - i.e. where it falls, minus the look-ahead,
+    plus any latency the plugin is reporting (which can put it past the end of the block).
+    */
+    int getSampleOffset(juce::int64 tick, int numSamples);
+
+    /*
+    The latency the plugin reports to the host. The host then plays everything the plugin
+    outputs this much earlier, so sequence hits are output this much later to stay on the grid.
+    */
+    void setOutputLatencySamples(int _outputLatencySamples);
+
+    /*
+    Sequence hits are output this many samples early (e.g. to make up for a sampler's latency
+    after the plugin), scheduled from where the Transport will be rather than where it is.
+    Notes for detected events aren't affected.
+    */
+    void setLookAheadSamples(int _lookAheadSamples);
+    int getLookAheadSamples();
+
+    /*
+    A length in ticks (e.g. a gate length) in samples, at the current tempo.
+    */
+    juce::int64 ticksToSamples(juce::int64 ticks);
+
+    /*
+    The gate length (in ticks) of the notes output for detected events / releases.
+    */
+    int getEventGateLength();
+
 private:
     
     // maintaining / updating beat position
     float sampleRate;
     float tempo;
-    float beatsPerSample;
-    float beatPosition;
-    const int maxNumBeats = 64;
+    Transport transport;
+    BeatGrid beatGrid; // <- updated once per block, straight after the transport advances
+    int lookAheadSamples = 0;
+    int outputLatencySamples = 0;
+
+    /*
+    The tick position sequences are scheduled up to: the end of the current block plus the look-ahead.
+    */
+    juce::int64 getSequencingTickPosition();
+
+    // for syncing to the host's transport:
+    bool hostSyncing = false;
+    bool hostPlaying = false;
+    const juce::int64 hostRelocationThreshold = Transport::ticksPerBeat / 32;
+
+    /*
+    Makes every Sequence forget which step it last output, e.g. after the host
+    transport has jumped somewhere else.
+    */
+    void resetSequences();
 
     // for tempo adaptation:
     bool adaptingTempo = false;
@@ -182,20 +376,63 @@ private:
     int subBeatsConsidered = 4;
 
     // sequences
-    int numSequences;
-    std::vector<Sequence*> sequences;
+    SequenceBank sequenceBank;
     std::vector<State> states;
+
+    // transitions: the tick each turningOn / turningOff sequence switches at,
+    // worked out once (from the quantum) when the transition starts
+    TransitionQuantum transitionQuantum = TransitionQuantum::endOfPattern;
+    std::vector<juce::int64> transitionTicks;
+
+    /*
+    The first boundary of the current transition quantum after a tick, for a sequence.
+    */
+    juce::int64 nextTransitionTick(int index, juce::int64 tick);
     int numTransitionRules;
     std::vector<TransitionRule*> transitionRules;
 
+    // queued edits from the UI
+    EditQueue editQueue;
+
+    void applyEdit(const EditCommand& command, const StepPattern& stagedPattern);
+
+    // scheduling of sequence hits: only sequences that are on (or still turning off)
+    // are in the scheduler, keyed on the tick of their next hit
+    SequenceScheduler scheduler;
+    std::vector<SequenceHit> dueHits;
+    int numDueHits = 0;
+    int numTransitioning = 0; // <- how many states are turningOn / turningOff
+
+    /*
+    All changes to states go through this, so the scheduler can be kept up to date.
+    Any sequence which starts outputting is scheduled from its first hit after fromTick,
+    and any sequence which starts transitioning gets its transition tick from fromTick.
+    */
+    void changeState(int index, State newState, juce::int64 fromTick);
+
+    static bool isOutputtingState(State state)
+    {
+        return state == State::on || state == State::turningOff;
+    }
+
+    static bool isTransitioningState(State state)
+    {
+        return state == State::turningOn || state == State::turningOff;
+    }
+
     // the event detector
     EventDetector *eventDetector;
+    AnalysisWorker* analysisWorker = nullptr;
+
+    int ruleEvaluationInterval = 1;
+    int blocksUntilRuleEvaluation = 0;
     std::vector<int> eventMidiValues = { 36, 46, 52 };
     std::vector<bool> eventMidiValuesOn = { true, false, false };
     std::vector<int> eventMidiVelocities = { 110, 110, 110} ;
     std::vector<int> eventReleaseMidiValues = { 39, 53 };
     std::vector<bool> eventReleaseMidiValuesOn = { true, false };
     std::vector<int> eventReleaseMidiVelocities = { 110, 110 };
+    int eventGateLength = Transport::ticksPerBeat / 8;
 
 };
 
@@ -0,0 +1,587 @@
+/*
+  ==============================================================================
+
+    StateSerializer.h
+    Created: 18 Oct 2026 11:58:20pm
+    Author:  User
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+#include "StateHandler.h"
+#include "TransitionRule.h"
+
+/*
+Saves and loads the plugin's whole state - the parameters, and everything the StateHandler holds
+which isn't a parameter (the sequences with their patterns and lanes, midi notes and velocities,
+the event midi notes, tempo / adaptation settings and the rule graph's settings) - in a compact,
+versioned binary format:
+
+    u32 magic ("ASEQ"), u16 version
+    parameters:   u16 count, then per parameter: u8 id length, id, f32 (normalised) value
+    settings:     f32 tempo, u8 adapting, f32 adaptation speed, f32 adaptation bias,
+                  u8 host syncing, u8 transition quantum
+    event midi:   u8 count, then per note: u8 note, u8 velocity, u8 on (then the same for releases)
+    sequences:    u16 count, then per sequence: u16 slot, u8 note, u8 velocity, u16 beats,
+                  u16 beat divisions, i32 gate length, u8 on, u16 pattern size, the pattern's
+                  u64 hit words, u8 has lanes, and if so per step: u8 velocity, u8 probability,
+                  i16 offset, u16 gate
+    rules:        u16 count, then per rule: u8 one way, u8 count, per affected sequence: u16 index,
+                  u8 effect, then u8 count, per parameter: f32 value
+
+All little-endian. Writing reserves the (worst case) size once up front and then writes straight
+into the block, so there's no allocation per element.
+
+Loading is split into read() and apply(). read() is the single validation pass: it parses the
+whole block into an EngineState, checking every count, range and length as it goes, and fails
+without touching anything if any of it is wrong. apply() then just copies a valid EngineState in.
+
+The rule graph itself (which rule feeds into which) is built in code, so only its settings are
+saved - and they're only restored if the saved graph has the same shape as the current one.
+*/
+class StateSerializer
+{
+public:
+
+    static constexpr juce::uint32 magic = 0x51455341; // <- "ASEQ"
+    static constexpr int version = 1;
+
+    struct SavedSequence
+    {
+        int slot, midiValue, midiVelocity, numBeats, numBeatDivisions, gateLength;
+        bool on;
+        int patternSize;
+        std::vector<juce::uint64> words;
+        bool hasLanes;
+        std::vector<juce::uint8> velocities, probabilities;
+        std::vector<juce::int16> offsets;
+        std::vector<juce::uint16> gates;
+    };
+
+    struct SavedRule
+    {
+        bool oneWay;
+        std::vector<int> statesChanged;
+        std::vector<TransitionRule::Effect> effects;
+        std::vector<float> parameters;
+    };
+
+    struct SavedEventMidi
+    {
+        int midiValue, midiVelocity;
+        bool on;
+    };
+
+    /*
+    Everything read from a saved state (by read(), ready for apply()).
+    */
+    struct EngineState
+    {
+        std::vector<juce::String> parameterIds;
+        std::vector<float> parameterValues;
+
+        float tempo, adaptationSpeed, adaptationBias;
+        bool adaptingTempo, hostSyncing;
+        int transitionQuantum;
+
+        std::vector<SavedEventMidi> eventMidi, eventReleaseMidi;
+        std::vector<SavedSequence> sequences;
+        std::vector<SavedRule> rules;
+    };
+
+    /*
+    Whether a block of data was written by write() (rather than being an older, XML, state).
+    */
+    static bool isEngineState(const void* data, int sizeInBytes)
+    {
+        Reader reader(data, sizeInBytes);
+        return reader.readU32() == magic && reader.ok;
+    }
+
+    /// <summary>
+    /// Write the whole state into destData (message thread).
+    /// </summary>
+    /// <param name="destData"> the block to write into (replacing its contents).</param>
+    /// <param name="parameters"> the plugin's parameters.</param>
+    /// <param name="stateHandler"> the plugin's StateHandler.</param>
+    /// <param name="rules"> every TransitionRule in the rule graph, in a fixed order.</param>
+    static void write(juce::MemoryBlock& destData, const juce::Array<juce::AudioProcessorParameter*>& parameters,
+                      StateHandler& stateHandler, const std::vector<TransitionRule*>& rules)
+    {
+        destData.setSize(getMaxSize(parameters, stateHandler, rules));
+        Writer writer((juce::uint8*)destData.getData());
+
+        writer.writeU32(magic);
+        writer.writeU16(version);
+
+        writer.writeU16(parameters.size());
+        for (auto* parameter : parameters)
+        {
+            juce::String id = getParameterId(parameter);
+            int length = juce::jmin((int)id.getNumBytesAsUTF8(), 255);
+            writer.writeU8(length);
+            writer.writeBytes(id.toRawUTF8(), length);
+            writer.writeFloat(parameter->getValue());
+        }
+
+        writer.writeFloat(stateHandler.getTempo());
+        writer.writeU8(stateHandler.isAdaptingTempo() ? 1 : 0);
+        writer.writeFloat(stateHandler.getAdaptationSpeed());
+        writer.writeFloat(stateHandler.getAdaptationBias());
+        writer.writeU8(stateHandler.isHostSyncing() ? 1 : 0);
+        writer.writeU8(stateHandler.getTransitionQuantum());
+
+        writeEventMidi(writer, stateHandler, false);
+        writeEventMidi(writer, stateHandler, true);
+
+        writer.writeU16(stateHandler.getNumSequences() > 0 ? countSequences(stateHandler) : 0);
+        for (int i = 0; i < stateHandler.getNumSequences(); i++)
+        {
+            if (stateHandler.isSequenceInUse(i)) writeSequence(writer, stateHandler, i);
+        }
+
+        writer.writeU16((int)rules.size());
+        for (TransitionRule* rule : rules)
+        {
+            writer.writeU8(rule->isOneWay() ? 1 : 0);
+
+            std::vector<int>* statesChanged = rule->getStatesChanged();
+            int numStatesChanged = juce::jmin((int)statesChanged->size(), 255);
+            writer.writeU8(numStatesChanged);
+            for (int s = 0; s < numStatesChanged; s++)
+            {
+                writer.writeU16((*statesChanged)[s]);
+                writer.writeU8(rule->getEffect(s));
+            }
+
+            int numParameters = juce::jmin(rule->getNumParameters(), 255);
+            writer.writeU8(numParameters);
+            for (int p = 0; p < numParameters; p++) writer.writeFloat(rule->getParameter(p));
+        }
+
+        destData.setSize(writer.position);
+    }
+
+    /// <summary>
+    /// Parse and validate a block written by write() (the single validation pass).
+    /// </summary>
+    /// <param name="data"> the block.</param>
+    /// <param name="sizeInBytes"> its size.</param>
+    /// <param name="maxNumSequences"> the StateHandler's capacity (slots must be below it).</param>
+    /// <param name="state"> filled in with what was read.</param>
+    /// <returns> false if the block isn't a valid state (state is then unusable).</returns>
+    static bool read(const void* data, int sizeInBytes, int maxNumSequences, EngineState& state)
+    {
+        Reader reader(data, sizeInBytes);
+
+        if (reader.readU32() != magic) return false;
+        int dataVersion = reader.readU16();
+        if (!reader.ok || dataVersion < 1 || dataVersion > version) return false;
+
+        int numParameters = reader.readU16();
+        for (int i = 0; i < numParameters && reader.ok; i++)
+        {
+            int length = reader.readU8();
+            const char* id = (const char*)reader.skip(length);
+            float value = reader.readFloat();
+            if (!reader.ok || !(value >= 0.0f && value <= 1.0f)) return false;
+
+            state.parameterIds.push_back(juce::String::fromUTF8(id, length));
+            state.parameterValues.push_back(value);
+        }
+
+        state.tempo = reader.readFloat();
+        state.adaptingTempo = reader.readU8() != 0;
+        state.adaptationSpeed = reader.readFloat();
+        state.adaptationBias = reader.readFloat();
+        state.hostSyncing = reader.readU8() != 0;
+        state.transitionQuantum = reader.readU8();
+        if (!reader.ok || !(state.tempo >= 1.0f && state.tempo <= 1000.0f)
+            || state.transitionQuantum > StateHandler::endOfPattern) return false;
+
+        if (!readEventMidi(reader, state.eventMidi) || !readEventMidi(reader, state.eventReleaseMidi)) return false;
+
+        int numSequences = reader.readU16();
+        if (!reader.ok || numSequences > maxNumSequences) return false;
+        std::vector<bool> slotUsed(maxNumSequences, false);
+        state.sequences.resize(numSequences);
+        for (auto& sequence : state.sequences)
+        {
+            if (!readSequence(reader, sequence)) return false;
+            if (sequence.slot >= maxNumSequences || slotUsed[sequence.slot]) return false;
+            slotUsed[sequence.slot] = true;
+        }
+
+        int numRules = reader.readU16();
+        state.rules.resize(reader.ok ? numRules : 0);
+        for (auto& rule : state.rules)
+        {
+            rule.oneWay = reader.readU8() != 0;
+            int numStatesChanged = reader.readU8();
+            for (int s = 0; s < numStatesChanged && reader.ok; s++)
+            {
+                int index = reader.readU16();
+                int effect = reader.readU8();
+                if (index >= maxNumSequences || effect > TransitionRule::turnOn) return false;
+                rule.statesChanged.push_back(index);
+                rule.effects.push_back((TransitionRule::Effect)effect);
+            }
+            int numRuleParameters = reader.readU8();
+            for (int p = 0; p < numRuleParameters && reader.ok; p++)
+            {
+                float value = reader.readFloat();
+                if (!std::isfinite(value)) return false;
+                rule.parameters.push_back(value);
+            }
+            if (!reader.ok) return false;
+        }
+
+        // and nothing left over
+        return reader.ok && reader.position == reader.size;
+    }
+
+    /// <summary>
+    /// Copy a validated EngineState into the plugin (message thread, with the audio
+    /// thread not processing - i.e. before prepareToPlay, or with processing suspended).
+    /// </summary>
+    static void apply(const EngineState& state, const juce::Array<juce::AudioProcessorParameter*>& parameters,
+                      StateHandler& stateHandler, const std::vector<TransitionRule*>& rules)
+    {
+        for (int i = 0; i < (int)state.parameterIds.size(); i++)
+        {
+            for (auto* parameter : parameters)
+            {
+                if (getParameterId(parameter) == state.parameterIds[i])
+                {
+                    parameter->setValueNotifyingHost(state.parameterValues[i]);
+                    break;
+                }
+            }
+        }
+
+        stateHandler.setTempo(state.tempo);
+        stateHandler.setAdaptingTempo(state.adaptingTempo);
+        stateHandler.setAdaptationSpeed(state.adaptationSpeed);
+        stateHandler.setAdaptationBias(state.adaptationBias);
+        stateHandler.setHostSyncing(state.hostSyncing);
+        stateHandler.setTransitionQuantum((StateHandler::TransitionQuantum)state.transitionQuantum);
+
+        int numEventMidi = juce::jmin((int)state.eventMidi.size(), (int)stateHandler.getEventMidiValues()->size());
+        for (int i = 0; i < numEventMidi; i++)
+        {
+            stateHandler.setEventMidiValue(i, state.eventMidi[i].midiValue);
+            stateHandler.setEventMidiVelocity(i, state.eventMidi[i].midiVelocity);
+            stateHandler.setEventMidiValueOn(i, state.eventMidi[i].on);
+        }
+        int numEventReleaseMidi = juce::jmin((int)state.eventReleaseMidi.size(), (int)stateHandler.getEventReleaseMidiValues()->size());
+        for (int i = 0; i < numEventReleaseMidi; i++)
+        {
+            stateHandler.setEventReleaseMidiValue(i, state.eventReleaseMidi[i].midiValue);
+            stateHandler.setEventReleaseMidiVelocity(i, state.eventReleaseMidi[i].midiVelocity);
+            stateHandler.setEventReleaseMidiValueOn(i, state.eventReleaseMidi[i].on);
+        }
+
+        stateHandler.clearSequences();
+        StepPattern staged;
+        for (const auto& saved : state.sequences)
+        {
+            if (!stateHandler.restoreSequence(saved.slot, saved.midiValue, saved.midiVelocity, saved.numBeats, saved.numBeatDivisions)) continue;
+
+            staged.clear();
+            staged.setSize(saved.patternSize);
+            for (int step = 0; step < saved.patternSize; step++)
+            {
+                if ((saved.words[step / 64] >> (step % 64)) & 1) staged.setStep(step, true);
+                if (saved.hasLanes)
+                {
+                    staged.setStepVelocity(step, saved.velocities[step]);
+                    staged.setStepProbability(step, saved.probabilities[step]);
+                    staged.setStepOffset(step, saved.offsets[step]);
+                    staged.setStepGate(step, saved.gates[step]);
+                }
+            }
+
+            Sequence* sequence = stateHandler.getSequencePtr(saved.slot);
+            sequence->applyPattern(saved.numBeats, saved.numBeatDivisions, staged);
+            sequence->setGateLength(saved.gateLength);
+            if (saved.on) stateHandler.setState(saved.slot, StateHandler::State::on);
+        }
+
+        // only if the rule graph is the same shape as the one saved
+        bool sameGraph = state.rules.size() == rules.size();
+        for (int r = 0; sameGraph && r < (int)rules.size(); r++)
+        {
+            sameGraph = (int)state.rules[r].parameters.size() == rules[r]->getNumParameters();
+        }
+        if (!sameGraph) return;
+
+        for (int r = 0; r < (int)rules.size(); r++)
+        {
+            const SavedRule& saved = state.rules[r];
+            rules[r]->setOneWay(saved.oneWay);
+            rules[r]->setStatesChanged(saved.statesChanged, saved.effects);
+            for (int p = 0; p < (int)saved.parameters.size(); p++) rules[r]->setParameter(p, saved.parameters[p]);
+        }
+    }
+
+private:
+
+    // =========================
+    // little-endian writing / reading
+
+    struct Writer
+    {
+        juce::uint8* data;
+        size_t position = 0;
+
+        Writer(juce::uint8* _data) : data(_data) {}
+
+        void writeU8(int value)
+        {
+            data[position++] = (juce::uint8)value;
+        }
+
+        void writeU16(int value)
+        {
+            writeU8(value & 0xff);
+            writeU8((value >> 8) & 0xff);
+        }
+
+        void writeU32(juce::uint32 value)
+        {
+            for (int b = 0; b < 4; b++) writeU8((int)((value >> (8 * b)) & 0xff));
+        }
+
+        void writeU64(juce::uint64 value)
+        {
+            for (int b = 0; b < 8; b++) writeU8((int)((value >> (8 * b)) & 0xff));
+        }
+
+        void writeFloat(float value)
+        {
+            juce::uint32 bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            writeU32(bits);
+        }
+
+        void writeBytes(const void* bytes, int numBytes)
+        {
+            std::memcpy(data + position, bytes, (size_t)numBytes);
+            position += (size_t)numBytes;
+        }
+    };
+
+    /*
+    Reading past the end sets ok to false (and returns zeros), so the
+    checks can be done once per section rather than after every value.
+    */
+    struct Reader
+    {
+        const juce::uint8* data;
+        size_t size;
+        size_t position = 0;
+        bool ok = true;
+
+        Reader(const void* _data, int sizeInBytes) : data((const juce::uint8*)_data), size((size_t)juce::jmax(0, sizeInBytes)) {}
+
+        const void* skip(int numBytes)
+        {
+            if (!ok || position + (size_t)numBytes > size)
+            {
+                ok = false;
+                return data;
+            }
+            const void* bytes = data + position;
+            position += (size_t)numBytes;
+            return bytes;
+        }
+
+        int readU8()
+        {
+            return ok && position < size ? data[position++] : (ok = false, 0);
+        }
+
+        int readU16()
+        {
+            int low = readU8();
+            return low | (readU8() << 8);
+        }
+
+        juce::uint32 readU32()
+        {
+            juce::uint32 value = 0;
+            for (int b = 0; b < 4; b++) value |= (juce::uint32)readU8() << (8 * b);
+            return value;
+        }
+
+        juce::uint64 readU64()
+        {
+            juce::uint64 value = 0;
+            for (int b = 0; b < 8; b++) value |= (juce::uint64)readU8() << (8 * b);
+            return value;
+        }
+
+        float readFloat()
+        {
+            juce::uint32 bits = readU32();
+            float value;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+    };
+
+    // =========================
+
+    static juce::String getParameterId(juce::AudioProcessorParameter* parameter)
+    {
+        if (auto* withId = dynamic_cast<juce::AudioProcessorParameterWithID*>(parameter)) return withId->paramID;
+        return juce::String(parameter->getParameterIndex());
+    }
+
+    static int countSequences(StateHandler& stateHandler)
+    {
+        int numSequences = 0;
+        for (int i = 0; i < stateHandler.getNumSequences(); i++)
+        {
+            if (stateHandler.isSequenceInUse(i)) numSequences += 1;
+        }
+        return numSequences;
+    }
+
+    /*
+    The most bytes write() could need, so the block can be sized once.
+    */
+    static size_t getMaxSize(const juce::Array<juce::AudioProcessorParameter*>& parameters,
+                             StateHandler& stateHandler, const std::vector<TransitionRule*>& rules)
+    {
+        size_t maxSize = 6 + 2 + (size_t)parameters.size() * (1 + 255 + 4) + 15;
+        maxSize += 2 * (1 + 255 * 3);
+
+        maxSize += 2;
+        for (int i = 0; i < stateHandler.getNumSequences(); i++)
+        {
+            if (!stateHandler.isSequenceInUse(i)) continue;
+            int size = stateHandler.getSequencePtr(i)->getPatternSize();
+            maxSize += 17 + (size_t)((size + 63) / 64) * 8 + 1 + (size_t)size * 6;
+        }
+
+        maxSize += 2 + rules.size() * (3 + 255 * 3 + 255 * 4);
+        return maxSize;
+    }
+
+    static void writeEventMidi(Writer& writer, StateHandler& stateHandler, bool release)
+    {
+        std::vector<int>* values = release ? stateHandler.getEventReleaseMidiValues() : stateHandler.getEventMidiValues();
+        std::vector<int>* velocities = release ? stateHandler.getEventReleaseMidiVelocities() : stateHandler.getEventMidiVelocities();
+        int count = juce::jmin((int)values->size(), 255);
+
+        writer.writeU8(count);
+        for (int i = 0; i < count; i++)
+        {
+            bool on = release ? stateHandler.getEventReleaseMidiValuesOn(i) : stateHandler.getEventMidiValuesOn(i);
+            writer.writeU8((*values)[i]);
+            writer.writeU8((*velocities)[i]);
+            writer.writeU8(on ? 1 : 0);
+        }
+    }
+
+    static bool readEventMidi(Reader& reader, std::vector<SavedEventMidi>& eventMidi)
+    {
+        int count = reader.readU8();
+        for (int i = 0; i < count && reader.ok; i++)
+        {
+            SavedEventMidi saved;
+            saved.midiValue = reader.readU8();
+            saved.midiVelocity = reader.readU8();
+            saved.on = reader.readU8() != 0;
+            if (saved.midiValue > 127 || saved.midiVelocity > 127) return false;
+            eventMidi.push_back(saved);
+        }
+        return reader.ok;
+    }
+
+    static void writeSequence(Writer& writer, StateHandler& stateHandler, int index)
+    {
+        Sequence* sequence = stateHandler.getSequencePtr(index);
+        StepPattern* pattern = sequence->getPatternPtr();
+        int size = pattern->getSize();
+
+        // (a sequence part way through switching is saved as what it's switching to)
+        StateHandler::State state = stateHandler.getState(index);
+        bool on = (state == StateHandler::State::on || state == StateHandler::State::turningOn);
+
+        writer.writeU16(index);
+        writer.writeU8(sequence->getMidiValue());
+        writer.writeU8(sequence->getMidiVelocity());
+        writer.writeU16(sequence->getNumBeats());
+        writer.writeU16(sequence->getNumBeatDivisions());
+        writer.writeU32((juce::uint32)sequence->getGateLength());
+        writer.writeU8(on ? 1 : 0);
+        writer.writeU16(size);
+
+        bool hasLanes = false;
+        for (int w = 0; w < (size + 63) / 64; w++)
+        {
+            juce::uint64 word = 0;
+            for (int b = 0; b < 64 && w * 64 + b < size; b++)
+            {
+                int step = w * 64 + b;
+                if (pattern->getStep(step)) word |= ((juce::uint64)1) << b;
+                hasLanes = hasLanes || pattern->hasLaneValues(step);
+            }
+            writer.writeU64(word);
+        }
+
+        writer.writeU8(hasLanes ? 1 : 0);
+        if (!hasLanes) return;
+
+        for (int step = 0; step < size; step++)
+        {
+            writer.writeU8(pattern->getStepVelocity(step));
+            writer.writeU8(pattern->getStepProbability(step));
+            writer.writeU16((juce::uint16)pattern->getStepOffset(step));
+            writer.writeU16(pattern->getStepGate(step));
+        }
+    }
+
+    static bool readSequence(Reader& reader, SavedSequence& sequence)
+    {
+        sequence.slot = reader.readU16();
+        sequence.midiValue = reader.readU8();
+        sequence.midiVelocity = reader.readU8();
+        sequence.numBeats = reader.readU16();
+        sequence.numBeatDivisions = reader.readU16();
+        sequence.gateLength = (int)reader.readU32();
+        sequence.on = reader.readU8() != 0;
+        sequence.patternSize = reader.readU16();
+
+        if (!reader.ok || sequence.midiValue > 127 || sequence.midiVelocity > 127
+            || !StepPattern::isValidLength(sequence.numBeats, sequence.numBeatDivisions) || sequence.gateLength < 1
+            || sequence.patternSize != sequence.numBeats * sequence.numBeatDivisions) return false;
+
+        sequence.words.resize((sequence.patternSize + 63) / 64);
+        for (auto& word : sequence.words) word = reader.readU64();
+
+        sequence.hasLanes = reader.readU8() != 0;
+        if (sequence.hasLanes)
+        {
+            sequence.velocities.resize(sequence.patternSize);
+            sequence.probabilities.resize(sequence.patternSize);
+            sequence.offsets.resize(sequence.patternSize);
+            sequence.gates.resize(sequence.patternSize);
+            for (int step = 0; step < sequence.patternSize && reader.ok; step++)
+            {
+                sequence.velocities[step] = (juce::uint8)reader.readU8();
+                sequence.probabilities[step] = (juce::uint8)reader.readU8();
+                sequence.offsets[step] = (juce::int16)reader.readU16();
+                sequence.gates[step] = (juce::uint16)reader.readU16();
+                if (sequence.velocities[step] > 127 || sequence.probabilities[step] > 100) return false;
+            }
+        }
+        return reader.ok;
+    }
+};
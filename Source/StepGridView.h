@@ -0,0 +1,158 @@
+/*
+  ==============================================================================
+
+    StepGridView.h
+    Created: 19 Oct 2026 1:38:26am
+    Author:  User
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "StepPattern.h"
+
+/*
+A StepGridView shows a Sequence's pattern as a row of steps - active steps lit up (brighter for
+louder per-step velocities), with a darker line at the start of every beat - and the step
+playing now highlighted.
+
+The grid itself only changes when the pattern does, so it's rendered once into a cached image
+(setPattern()). Each frame just moves the playhead (setBeatPosition()), which only repaints the
+step it leaves and the step it moves to: blitting those two cells from the image plus the
+overlay. So lots of these can be animating at once.
+*/
+class StepGridView : public juce::Component
+{
+public:
+
+    StepGridView()
+    {
+        setOpaque(true);
+        setInterceptsMouseClicks(false, false);
+    }
+
+    /// <summary>
+    /// Show a pattern (message thread). Re-renders the cached image.
+    /// </summary>
+    /// <param name="newPattern"> the pattern (copied).</param>
+    /// <param name="_numBeats"> its number of beats.</param>
+    /// <param name="_numBeatDivisions"> its steps per beat.</param>
+    void setPattern(const StepPattern& newPattern, int _numBeats, int _numBeatDivisions)
+    {
+        pattern.copyFrom(newPattern);
+        numBeats = juce::jmax(1, _numBeats);
+        numBeatDivisions = juce::jmax(1, _numBeatDivisions);
+        playheadStep = -1;
+
+        renderGrid();
+        repaint();
+    }
+
+    /*
+    Move the playhead to the step playing at a beat position (e.g. from the latest TelemetryFrame).
+    Loops line up with beat 0, as the Sequence's own loops do.
+    */
+    void setBeatPosition(float beatPosition)
+    {
+        int size = pattern.getSize();
+        if (size <= 0) return;
+
+        double positionInLoop = beatPosition - numBeats * std::floor(beatPosition / numBeats);
+        int step = juce::jlimit(0, size - 1, (int)(positionInLoop * numBeatDivisions));
+        if (step == playheadStep) return;
+
+        if (playheadStep >= 0) repaint(getStepBounds(playheadStep));
+        playheadStep = step;
+        repaint(getStepBounds(playheadStep));
+    }
+
+    void paint(juce::Graphics& g) override
+    {
+        if (!gridImage.isValid())
+        {
+            g.fillAll(emptyColour);
+            return;
+        }
+
+        g.drawImageAt(gridImage, 0, 0);
+
+        if (playheadStep >= 0)
+        {
+            auto bounds = getStepBounds(playheadStep);
+            g.setColour(juce::Colours::white.withAlpha(0.35f));
+            g.fillRect(bounds);
+            g.setColour(juce::Colours::white);
+            g.drawRect(bounds);
+        }
+    }
+
+    void resized() override
+    {
+        renderGrid();
+    }
+
+private:
+    StepPattern pattern;
+    int numBeats = 1;
+    int numBeatDivisions = 1;
+    int playheadStep = -1;
+
+    juce::Image gridImage;
+
+    const juce::Colour emptyColour = juce::Colour(0xff202020);
+    const juce::Colour activeColour = juce::Colours::lightskyblue;
+    const juce::Colour beatLineColour = juce::Colours::black;
+
+    /*
+    A step's cell (the steps share the width out as evenly as whole pixels allow).
+    */
+    juce::Rectangle<int> getStepBounds(int step)
+    {
+        int size = juce::jmax(1, pattern.getSize());
+        int left = (step * getWidth()) / size;
+        int right = ((step + 1) * getWidth()) / size;
+        return { left, 0, juce::jmax(1, right - left), getHeight() };
+    }
+
+    void renderGrid()
+    {
+        if (getWidth() <= 0 || getHeight() <= 0)
+        {
+            gridImage = juce::Image();
+            return;
+        }
+
+        if (!gridImage.isValid() || gridImage.getWidth() != getWidth() || gridImage.getHeight() != getHeight())
+        {
+            gridImage = juce::Image(juce::Image::RGB, getWidth(), getHeight(), false);
+        }
+
+        juce::Graphics g(gridImage);
+        g.fillAll(emptyColour);
+
+        for (int step = 0; step < pattern.getSize(); step++)
+        {
+            auto bounds = getStepBounds(step);
+
+            if (pattern.getStep(step))
+            {
+                // (velocity 0 means the Sequence's own velocity, so full brightness)
+                int velocity = pattern.getStepVelocity(step);
+                float brightness = velocity == 0 ? 1.0f : 0.3f + 0.7f * (velocity / 127.0f);
+                g.setColour(activeColour.withMultipliedBrightness(brightness));
+                g.fillRect(bounds.reduced(bounds.getWidth() > 3 ? 1 : 0, 2));
+            }
+
+            if (step % numBeatDivisions == 0)
+            {
+                g.setColour(beatLineColour);
+                g.fillRect(bounds.getX(), 0, 1, getHeight());
+            }
+        }
+    }
+
+    //==============================================================
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(StepGridView)
+};
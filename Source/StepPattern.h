@@ -0,0 +1,307 @@
+/*
+  ==============================================================================
+
+    StepPattern.h
+    Created: 18 Oct 2026 11:40:52am
+    Author:  User
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#if defined(_MSC_VER)
+ #include <intrin.h>
+#endif
+
+/*
+A fixed-capacity on/off step pattern for a Sequence, stored as an array of 64-bit words
+(step i is bit (i % 64) of word (i / 64)).
+
+Compared to a std::vector<bool>, there's no proxy object when indexing, nothing gets
+allocated when the size changes, finding the next active step is a count-trailing-zeros
+per word rather than a linear scan, and copying a whole pattern is just a few words.
+
+Bits at or beyond getSize() are always kept at zero, so the searching / counting
+functions below never need to mask the last word.
+
+Alongside the hit bits, each step has a velocity, a trigger probability, a micro-timing
+offset and a gate length, stored structure-of-arrays style (one small array per 'lane') so a humanized hit
+only costs a couple of array lookups:
+  - velocity: 1 to 127, or 0 to just use the Sequence's midi velocity.
+  - probability: percentage chance (0 to 100) of the step actually triggering.
+  - offset: how many ticks early (negative) or late (positive) the step plays.
+  - gate: how many ticks the note lasts, or 0 to just use the Sequence's gate length.
+*/
+class StepPattern
+{
+public:
+
+    static constexpr int maxNumSteps = 1024;
+    static constexpr int numWords = maxNumSteps / 64;
+
+    static constexpr juce::uint8 defaultVelocity = 0;
+    static constexpr juce::uint8 defaultProbability = 100;
+    static constexpr juce::int16 defaultOffset = 0;
+    static constexpr juce::uint16 defaultGate = 0;
+
+    StepPattern()
+    {
+        clear();
+    }
+
+    /*
+    Turn every step off and reset the velocity / probability / offset / gate lanes
+    (the size is left as it is).
+    */
+    void clear()
+    {
+        for (int w = 0; w < numWords; w++)
+        {
+            words[w] = 0;
+        }
+        resetLanes(0, maxNumSteps);
+    }
+
+    /// <summary>
+    /// Set the number of steps in the pattern (clamped to maxNumSteps). Steps which
+    /// are cut off by shrinking the pattern are turned off, and new steps start off.
+    /// </summary>
+    /// <param name="newSize"> the new number of steps.</param>
+    void setSize(int newSize)
+    {
+        newSize = juce::jlimit(0, maxNumSteps, newSize);
+
+        // clear everything from newSize onwards
+        for (int w = newSize / 64; w < numWords; w++)
+        {
+            int firstBit = (w == newSize / 64) ? (newSize % 64) : 0;
+            words[w] &= lowBitsMask(firstBit);
+        }
+        if (newSize < size) resetLanes(newSize, size);
+        size = newSize;
+    }
+
+    int getSize()
+    {
+        return size;
+    }
+
+    /*
+    Whether a sequence length fits in a pattern: at least one beat and one division, and no more
+    than maxNumSteps steps in all (compared by division, so huge values can't overflow).
+    Lengths which don't fit should be rejected, rather than the pattern being cut short by setSize().
+    */
+    static bool isValidLength(int numBeats, int numBeatDivisions)
+    {
+        return numBeats >= 1 && numBeatDivisions >= 1 && numBeats <= maxNumSteps / numBeatDivisions;
+    }
+
+    void setStep(int index, bool value)
+    {
+        if (index < 0 || index >= size) return;
+
+        juce::uint64 bit = ((juce::uint64)1) << (index % 64);
+        if (value) words[index / 64] |= bit;
+        else words[index / 64] &= ~bit;
+    }
+
+    bool getStep(int index)
+    {
+        return ((words[index / 64] >> (index % 64)) & 1) != 0;
+    }
+
+    // =========================
+    // the per-step lanes:
+
+    void setStepVelocity(int index, int velocity)
+    {
+        if (index >= 0 && index < size) velocities[index] = (juce::uint8)juce::jlimit(0, 127, velocity);
+    }
+
+    juce::uint8 getStepVelocity(int index)
+    {
+        return velocities[index];
+    }
+
+    void setStepProbability(int index, int probability)
+    {
+        if (index >= 0 && index < size) probabilities[index] = (juce::uint8)juce::jlimit(0, 100, probability);
+    }
+
+    juce::uint8 getStepProbability(int index)
+    {
+        return probabilities[index];
+    }
+
+    void setStepOffset(int index, int offsetInTicks)
+    {
+        if (index >= 0 && index < size) offsets[index] = (juce::int16)juce::jlimit(-32768, 32767, offsetInTicks);
+    }
+
+    juce::int16 getStepOffset(int index)
+    {
+        return offsets[index];
+    }
+
+    void setStepGate(int index, int gateInTicks)
+    {
+        if (index >= 0 && index < size) gates[index] = (juce::uint16)juce::jlimit(0, 65535, gateInTicks);
+    }
+
+    juce::uint16 getStepGate(int index)
+    {
+        return gates[index];
+    }
+
+    /*
+    Does a step have anything other than the default velocity / probability / offset / gate?
+    */
+    bool hasLaneValues(int index)
+    {
+        return velocities[index] != defaultVelocity
+            || probabilities[index] != defaultProbability
+            || offsets[index] != defaultOffset
+            || gates[index] != defaultGate;
+    }
+
+    /// <summary>
+    /// Find the next active step after a given step, wrapping back round to the start of the
+    /// pattern (so if the only active step is 'step' itself, 'step' is returned).
+    /// </summary>
+    /// <param name="step"> the step to search after (-1 to search from the start).</param>
+    /// <returns> the index of the next active step, or -1 if no steps are active.</returns>
+    int nextHitAfter(int step)
+    {
+        if (size <= 0) return -1;
+
+        int start = step + 1;
+        if (start >= size || start < 0) start = 0;
+
+        int hit = findFirstHit(start, size);
+        if (hit < 0) hit = findFirstHit(0, start);
+        return hit;
+    }
+
+    /*
+    The number of active steps in the pattern.
+    */
+    int getNumHits()
+    {
+        int numHits = 0;
+        for (int w = 0; w < numWordsInUse(); w++)
+        {
+            numHits += countBits(words[w]);
+        }
+        return numHits;
+    }
+
+    /*
+    The fraction of steps which are active (0.0 to 1.0).
+    */
+    float getDensity()
+    {
+        if (size <= 0) return 0.0f;
+        return (float)getNumHits() / size;
+    }
+
+    /*
+    Copy another pattern (steps, lanes and size) into this one - only the words / lane
+    entries in use are copied.
+    */
+    void copyFrom(const StepPattern& other)
+    {
+        int wordsToCopy = juce::jmax(numWordsInUse(), (other.size + 63) / 64);
+        for (int w = 0; w < wordsToCopy; w++)
+        {
+            words[w] = other.words[w];
+        }
+
+        int stepsToCopy = juce::jmax(size, other.size);
+        std::copy(other.velocities, other.velocities + stepsToCopy, velocities);
+        std::copy(other.probabilities, other.probabilities + stepsToCopy, probabilities);
+        std::copy(other.offsets, other.offsets + stepsToCopy, offsets);
+        std::copy(other.gates, other.gates + stepsToCopy, gates);
+
+        size = other.size;
+    }
+
+private:
+    juce::uint64 words[numWords];
+    int size = 0;
+
+    // the per-step lanes
+    juce::uint8 velocities[maxNumSteps];
+    juce::uint8 probabilities[maxNumSteps];
+    juce::int16 offsets[maxNumSteps];
+    juce::uint16 gates[maxNumSteps];
+
+    void resetLanes(int from, int to)
+    {
+        std::fill(velocities + from, velocities + to, defaultVelocity);
+        std::fill(probabilities + from, probabilities + to, defaultProbability);
+        std::fill(offsets + from, offsets + to, defaultOffset);
+        std::fill(gates + from, gates + to, defaultGate);
+    }
+
+    int numWordsInUse()
+    {
+        return (size + 63) / 64;
+    }
+
+    /*
+    Returns the first active step in the range [from, to), or -1 if there isn't one.
+    */
+    int findFirstHit(int from, int to)
+    {
+        if (from >= to) return -1;
+
+        int w = from / 64;
+        int lastWord = (to - 1) / 64;
+        juce::uint64 bits = words[w] & ~lowBitsMask(from % 64);
+
+        while (true)
+        {
+            if (bits != 0)
+            {
+                int hit = (w * 64) + countTrailingZeros(bits);
+                return (hit < to) ? hit : -1;
+            }
+            if (++w > lastWord) return -1;
+            bits = words[w];
+        }
+    }
+
+    /*
+    A mask with the lowest numBits bits set (numBits from 0 to 63).
+    */
+    static juce::uint64 lowBitsMask(int numBits)
+    {
+        return (((juce::uint64)1) << numBits) - 1;
+    }
+
+    // =======================================
+    // bit twiddling helpers (x must be non-zero for countTrailingZeros)
+
+    static int countTrailingZeros(juce::uint64 x)
+    {
+       #if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward64(&index, x);
+        return (int)index;
+       #else
+        return __builtin_ctzll(x);
+       #endif
+    }
+
+    static int countBits(juce::uint64 x)
+    {
+       #if defined(_MSC_VER)
+        return (int)__popcnt64(x);
+       #else
+        return __builtin_popcountll(x);
+       #endif
+    }
+};
@@ -0,0 +1,133 @@
+/*
+  ==============================================================================
+
+    TelemetryStream.h
+    Created: 19 Oct 2026 12:21:52am
+    Author:  User
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+
+/*
+What the engine saw and did in one processBlock() call - one of these is published per block.
+Fixed size (no pointers / containers), so publishing one is just a copy.
+*/
+struct TelemetryFrame
+{
+    static constexpr int maxNumSequences = 128; // <- the processor's SequenceBank capacity
+
+    juce::int64 position = 0; // <- input sample position of the start of the block
+    int numSamples = 0;
+
+    float volume = 0.0f;      // <- mean absolute level of the block
+    float density = 0.0f;     // <- the EventDetector's event density
+    float tempo = 0.0f;
+    float beatPosition = 0.0f;
+
+    bool onset = false;       // <- an event's notes went out in this block...
+    int onsetOffset = 0;      // <- ...at this sample offset
+    bool release = false;
+    int releaseOffset = 0;
+
+    int numSequences = 0;     // <- slots in use go up to this (see StateHandler::getNumSequences())
+    juce::int8 sequenceStates[maxNumSequences] = {}; // <- StateHandler::State values
+};
+
+/*
+A TelemetryStream carries TelemetryFrames from the audio thread to the editor, through a lock-free
+single-producer / single-consumer FIFO - so the editor gets every block's view of the engine without
+reading anything the audio thread is in the middle of writing, and the audio thread never waits.
+
+The audio thread fills a frame in place (beginFrame() / endFrame()). The editor drains everything
+that's arrived with readFrames() at its own rate. If the editor isn't open (or falls behind) and the
+FIFO fills up, new frames are dropped and counted.
+*/
+class TelemetryStream
+{
+public:
+
+    static constexpr int capacity = 1024; // <- about 0.7 s of 32 sample blocks at 48 kHz
+
+    TelemetryStream() : fifo(capacity), frames(capacity)
+    {
+    }
+
+    /*
+    Start again from position 0 with an empty FIFO (call this from prepareToPlay).
+    */
+    void prepare()
+    {
+        fifo.reset();
+        position = 0;
+        droppedFrames.store(0);
+    }
+
+    // =========================
+    // audio thread:
+
+    /*
+    The frame to fill in for this block, or nullptr if the FIFO's full (then there's no need to
+    call endFrame()). The frame may hold old values, so every field should be written.
+    */
+    TelemetryFrame* beginFrame(int numSamples)
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite(1, start1, size1, start2, size2);
+
+        if (size1 == 0)
+        {
+            droppedFrames.fetch_add(1);
+            position += numSamples;
+            return nullptr;
+        }
+
+        TelemetryFrame* frame = &frames[start1];
+        frame->position = position;
+        frame->numSamples = numSamples;
+        position += numSamples;
+        return frame;
+    }
+
+    /*
+    Publish the frame returned by beginFrame().
+    */
+    void endFrame()
+    {
+        fifo.finishedWrite(1);
+    }
+
+    // =========================
+    // message thread:
+
+    /*
+    Move every published frame into destFrames (which is cleared first, and
+    should have capacity reserved so this doesn't allocate).
+    */
+    void readFrames(std::vector<TelemetryFrame>& destFrames)
+    {
+        destFrames.clear();
+
+        int start1, size1, start2, size2;
+        fifo.prepareToRead(fifo.getNumReady(), start1, size1, start2, size2);
+        for (int i = 0; i < size1; i++) destFrames.push_back(frames[start1 + i]);
+        for (int i = 0; i < size2; i++) destFrames.push_back(frames[start2 + i]);
+        fifo.finishedRead(size1 + size2);
+    }
+
+    int getNumDroppedFrames()
+    {
+        return droppedFrames.load();
+    }
+
+private:
+    juce::AbstractFifo fifo;
+    std::vector<TelemetryFrame> frames;
+
+    juce::int64 position = 0; // <- audio thread's
+    std::atomic<int> droppedFrames { 0 };
+};
@@ -26,6 +26,7 @@ public:
     TempoUIBlock(Assignment3AudioProcessor* _audioProcessor)
     {
         audioProcessor = _audioProcessor;
+        setOpaque(true);
 
         using SliderAttachment = juce::AudioProcessorValueTreeState::SliderAttachment;
 
@@ -34,13 +35,35 @@ public:
         addAndMakeVisible(tempoLabel);
         tempoLabel.setText("Tempo", juce::dontSendNotification);
         tempoLabel.attachToComponent(&tempoSlider, true);
-        tempoSlider.onValueChange = [this] {audioProcessor->stateHandler.setTempo(tempoSlider.getValue()); };
+        tempoSlider.onValueChange = [this] {audioProcessor->stateHandler.pushEdit({ EditCommand::setTempo, 0, 0, 0, (float)tempoSlider.getValue() }); };
 
         addAndMakeVisible(adaptTempoToggle);
         addAndMakeVisible(adaptTempoLabel);
         adaptTempoLabel.setText("Adapt", juce::dontSendNotification);
         adaptTempoLabel.attachToComponent(&adaptTempoToggle, true);
-        adaptTempoToggle.onStateChange = [this] {audioProcessor->stateHandler.setAdaptingTempo(adaptTempoToggle.getToggleState()); };
+        adaptTempoToggle.onStateChange = [this] {audioProcessor->stateHandler.pushEdit({ EditCommand::setAdaptingTempo, 0, adaptTempoToggle.getToggleState() ? 1 : 0, 0, 0.0f }); };
+
+        addAndMakeVisible(hostSyncToggle);
+        addAndMakeVisible(hostSyncLabel);
+        hostSyncLabel.setText("Host sync", juce::dontSendNotification);
+        hostSyncLabel.attachToComponent(&hostSyncToggle, true);
+        hostSyncToggle.setToggleState(audioProcessor->stateHandler.isHostSyncing(), juce::dontSendNotification);
+        hostSyncToggle.onStateChange = [this] {audioProcessor->stateHandler.pushEdit({ EditCommand::setHostSyncing, 0, hostSyncToggle.getToggleState() ? 1 : 0, 0, 0.0f }); };
+
+        // (ComboBox ids start at 1, so id = TransitionQuantum + 1)
+        addAndMakeVisible(quantumBox);
+        addAndMakeVisible(quantumLabel);
+        quantumLabel.setText("Switch", juce::dontSendNotification);
+        quantumLabel.attachToComponent(&quantumBox, true);
+        quantumBox.addItemList({ "now", "step", "beat", "bar", "pattern" }, 1);
+        quantumBox.setSelectedId(audioProcessor->stateHandler.getTransitionQuantum() + 1, juce::dontSendNotification);
+        quantumBox.onChange = [this] {audioProcessor->stateHandler.pushEdit({ EditCommand::setTransitionQuantum, 0, quantumBox.getSelectedId() - 1, 0, 0.0f }); };
+
+        lookAheadAnalysisAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(audioProcessor->parameters, "look_ahead_analysis", lookAheadAnalysisToggle);
+        addAndMakeVisible(lookAheadAnalysisToggle);
+        addAndMakeVisible(lookAheadAnalysisLabel);
+        lookAheadAnalysisLabel.setText("Delay + analyse", juce::dontSendNotification);
+        lookAheadAnalysisLabel.attachToComponent(&lookAheadAnalysisToggle, true);
 
         addAndMakeVisible(sensitivitySlider);
         addAndMakeVisible(sensitivityLabel);
@@ -48,7 +71,7 @@ public:
         sensitivityLabel.attachToComponent(&sensitivitySlider, true);
         sensitivitySlider.setRange(0.0, 20.0, 0.1);
         sensitivitySlider.setValue(audioProcessor->stateHandler.getAdaptationSpeed(), juce::dontSendNotification);
-        sensitivitySlider.onValueChange = [this] {audioProcessor->stateHandler.setAdaptationSpeed(sensitivitySlider.getValue()); };
+        sensitivitySlider.onValueChange = [this] {audioProcessor->stateHandler.pushEdit({ EditCommand::setAdaptationSpeed, 0, 0, 0, (float)sensitivitySlider.getValue() }); };
 
         addAndMakeVisible(biasSlider);
         addAndMakeVisible(biasLabel);
@@ -56,15 +79,28 @@ public:
         biasLabel.attachToComponent(&biasSlider, true);
         biasSlider.setRange(-1.0, 1.0, 0.01);
         biasSlider.setValue(audioProcessor->stateHandler.getAdaptationBias(), juce::dontSendNotification);
-        biasSlider.onValueChange = [this] {audioProcessor->stateHandler.setAdaptationBias(biasSlider.getValue()); };
+        biasSlider.onValueChange = [this] {audioProcessor->stateHandler.pushEdit({ EditCommand::setAdaptationBias, 0, 0, 0, (float)biasSlider.getValue() }); };
+
+        lookAheadAttachment = std::make_unique<SliderAttachment>(audioProcessor->parameters, "sequence_look_ahead", lookAheadSlider);
+        addAndMakeVisible(lookAheadSlider);
+        addAndMakeVisible(lookAheadLabel);
+        lookAheadLabel.setText("Look-ahead (ms)", juce::dontSendNotification);
+        lookAheadLabel.attachToComponent(&lookAheadSlider, true);
     }
 
     /*
     When adapting tempo, this gets called to update the slider along with the changing tempo.
+    (without a notification, so the audio thread's own tempo isn't queued straight back to it
+    as an edit - by the time it arrived it would be out of date)
+    The slider's only touched when the tempo has moved by more than it can show, and not while
+    it's being dragged, so the editor's timer doesn't repaint it (or fight the user) every frame.
     */
-    void updateTempo()
+    void updateTempo(float tempo)
     {
-        tempoSlider.setValue(audioProcessor->stateHandler.getTempo());
+        if (std::abs(tempo - shownTempo) < minTempoChange || tempoSlider.isMouseButtonDown()) return;
+
+        shownTempo = tempo;
+        tempoSlider.setValue(tempo, juce::dontSendNotification);
     }
 
     /*
@@ -87,24 +123,40 @@ public:
 
         tempoSlider.setBounds(x + sliderLeft, y + 10, width - sliderLeft - 10, 20);
         adaptTempoToggle.setBounds(x + 60, y + 10, 20, 20);
+        hostSyncToggle.setBounds(x + 90, y + 30, 20, 20);
+        quantumBox.setBounds(x + 60, y + 52, 80, 20);
+        lookAheadAnalysisToggle.setBounds(x + 110, y + 74, 20, 20);
 
         sensitivitySlider.setBounds(x + sliderLeft, y + 30, width - sliderLeft - 10, 20);
         biasSlider.setBounds(x + sliderLeft, y + 50, width - sliderLeft - 10, 20);
+        lookAheadSlider.setBounds(x + sliderLeft, y + 70, width - sliderLeft - 10, 20);
     }
 
 private:
     Assignment3AudioProcessor* audioProcessor;
 
     juce::Slider tempoSlider;
+    float shownTempo = 0.0f;
+    const float minTempoChange = 0.01f; // <- BPM
     juce::Label tempoLabel;
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> tempoAttachment;
     juce::ToggleButton adaptTempoToggle;
     juce::Label adaptTempoLabel;
+    juce::ToggleButton hostSyncToggle;
+    juce::Label hostSyncLabel;
+    juce::ComboBox quantumBox;
+    juce::Label quantumLabel;
+    juce::ToggleButton lookAheadAnalysisToggle;
+    juce::Label lookAheadAnalysisLabel;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> lookAheadAnalysisAttachment;
     juce::Slider sensitivitySlider;
     juce::Label sensitivityLabel;
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> sensitivityAttachment;
     juce::Slider biasSlider;
     juce::Label biasLabel;
+    juce::Slider lookAheadSlider;
+    juce::Label lookAheadLabel;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> lookAheadAttachment;
 
     //==============================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TempoUIBlock)
@@ -83,6 +83,35 @@ public:
         return oneWayTransition;
     };
 
+    // ================================================================
+    // for saving / loading the rule graph (see StateSerializer): which sequences a rule
+    // affects and how, and the child class's own settings as a list of numbers
+
+    void setStatesChanged(std::vector<int> _statesChanged, std::vector<TransitionRule::Effect> _effects)
+    {
+        statesChanged = _statesChanged;
+        effects = _effects;
+    }
+
+    void setOneWay(bool _oneWayTransition)
+    {
+        oneWayTransition = _oneWayTransition;
+    }
+
+    virtual int getNumParameters()
+    {
+        return 0;
+    }
+
+    virtual float getParameter(int index)
+    {
+        return 0.0f;
+    }
+
+    virtual void setParameter(int index, float value)
+    {
+    }
+
 protected:
     StateHandler *stateHandler;
     std::vector<int> statesChanged;
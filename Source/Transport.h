@@ -0,0 +1,211 @@
+/*
+  ==============================================================================
+
+    Transport.h
+    Created: 18 Oct 2026 10:02:11am
+    Author:  User
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/*
+A Transport object keeps track of where we are in time, both as a 64-bit count of
+samples processed and as an integer 'tick' position (ticksPerBeat ticks per beat).
+
+The tick position is stored as a fixed-point number (integer ticks in the top bits,
+a fractional tick in the bottom fractionBits bits), and is advanced once per block
+with integer arithmetic only. Floats were previously accumulated every block, which
+slowly drifts over a long session - this doesn't.
+
+Everything else (Sequence, EventDetector, StateHandler) then derives its step / phase
+from getTickPosition() using integer division and modulo.
+*/
+class Transport
+{
+public:
+
+    // 960 divides nicely by 2, 3, 4, 5, 6, 8, 10, 12, 15, 16... so all the usual
+    // beat divisions land exactly on a whole tick.
+    static constexpr int ticksPerBeat = 960;
+
+    /// <summary>
+    /// Initialize the Transport. Resets the position back to zero.
+    /// </summary>
+    /// <param name="_sampleRate"> the sample rate the plugin is using.</param>
+    /// <param name="_tempo"> the tempo (beats per minute) to advance the tick position at.</param>
+    void initialize(double _sampleRate, float _tempo)
+    {
+        sampleRate = _sampleRate;
+        tempo = _tempo;
+        samplePosition = 0;
+        tickPositionFixed = 0;
+        prevTickPositionFixed = 0;
+        updateTicksPerSample();
+    }
+
+    void setSampleRate(double _sampleRate)
+    {
+        sampleRate = _sampleRate;
+        updateTicksPerSample();
+    }
+
+    void setTempo(float _tempo)
+    {
+        tempo = _tempo;
+        updateTicksPerSample();
+    }
+
+    float getTempo()
+    {
+        return tempo;
+    }
+
+    /// <summary>
+    /// Jump the tick position to a (host provided) position in beats / quarter notes.
+    /// The next advance() then carries on from here.
+    /// </summary>
+    /// <param name="ppqPosition"> the position in quarter notes, as given by an AudioPlayHead.</param>
+    void setPpqPosition(double ppqPosition)
+    {
+        tickPositionFixed = (juce::int64) std::llround(ppqPosition * ticksPerBeat * (double)fractionOne);
+    }
+
+    void setTimeSignature(int _numerator, int _denominator)
+    {
+        if (_numerator > 0 && _denominator > 0)
+        {
+            timeSigNumerator = _numerator;
+            timeSigDenominator = _denominator;
+        }
+    }
+
+    /*
+    Length of a bar in ticks, from the time signature (a beat / tick is always a quarter note).
+    */
+    juce::int64 getTicksPerBar()
+    {
+        return ((juce::int64)timeSigNumerator * ticksPerBeat * 4) / timeSigDenominator;
+    }
+
+    /// <summary>
+    /// Advance the transport by one block. Call this once per processBlock().
+    /// </summary>
+    /// <param name="numSamples"> the number of samples in the block.</param>
+    void advance(int numSamples)
+    {
+        prevTickPositionFixed = tickPositionFixed;
+        tickPositionFixed += ticksPerSampleFixed * numSamples;
+        samplePosition += numSamples;
+    }
+
+    // =========================
+    // some getters:
+
+    juce::int64 getSamplePosition()
+    {
+        return samplePosition;
+    }
+
+    /*
+    The whole number of ticks elapsed, after the most recent advance().
+    */
+    juce::int64 getTickPosition()
+    {
+        return floorDiv(tickPositionFixed, fractionOne);
+    }
+
+    /*
+    The tick position a number of samples after getTickPosition(), at the current tempo - i.e.
+    where the Transport will be, for anything which is output that far ahead of time.
+    */
+    juce::int64 getTickPositionAhead(int numSamplesAhead)
+    {
+        return floorDiv(tickPositionFixed + (ticksPerSampleFixed * numSamplesAhead), fractionOne);
+    }
+
+    /*
+    The whole number of ticks elapsed before the most recent advance(), i.e.
+    the tick position at the start of the current block.
+    */
+    juce::int64 getPrevTickPosition()
+    {
+        return floorDiv(prevTickPositionFixed, fractionOne);
+    }
+
+    /// <summary>
+    /// Find the sample within the current block (the one covered by the most recent advance())
+    /// at which a tick is reached.
+    /// </summary>
+    /// <param name="tick"> the tick, normally between getPrevTickPosition() and getTickPosition().</param>
+    /// <param name="numSamples"> the number of samples in the block.</param>
+    /// <param name="numSamplesEarly"> how many samples ahead of time the tick is being output (see getTickPositionAhead()).</param>
+    /// <returns> the sample offset, clamped to the block (0 to numSamples - 1).</returns>
+    int getSampleOffsetOfTick(juce::int64 tick, int numSamples, int numSamplesEarly = 0)
+    {
+        if (ticksPerSampleFixed <= 0 || numSamples <= 0) return 0;
+
+        juce::int64 distance = (tick * fractionOne) - prevTickPositionFixed;
+        if (distance <= 0) return 0;
+
+        juce::int64 offset = ((distance + ticksPerSampleFixed - 1) / ticksPerSampleFixed) - numSamplesEarly; // <- round up
+        return (int)juce::jlimit((juce::int64)0, (juce::int64)numSamples - 1, offset);
+    }
+
+    /*
+    A length in ticks converted to samples, at the current tempo (rounded down).
+    */
+    juce::int64 ticksToSamples(juce::int64 ticks)
+    {
+        if (ticksPerSampleFixed <= 0) return 0;
+        return (ticks * fractionOne) / ticksPerSampleFixed;
+    }
+
+    /*
+    Beat position as a double - only intended for display / debugging,
+    anything timing related should work with the tick position.
+    */
+    double getBeatPosition()
+    {
+        return (double)tickPositionFixed / ((double)ticksPerBeat * (double)fractionOne);
+    }
+
+    // ===================================================================
+    // integer helpers which round towards minus infinity, so that steps / phases
+    // still come out right for negative tick positions (e.g. a host's pre-roll)
+
+    static juce::int64 floorDiv(juce::int64 a, juce::int64 b)
+    {
+        juce::int64 q = a / b;
+        if ((a % b != 0) && ((a < 0) != (b < 0))) q -= 1;
+        return q;
+    }
+
+    static juce::int64 floorMod(juce::int64 a, juce::int64 b)
+    {
+        return a - (floorDiv(a, b) * b);
+    }
+
+private:
+    static constexpr int fractionBits = 32;
+    static constexpr juce::int64 fractionOne = ((juce::int64)1) << fractionBits;
+
+    double sampleRate = 44100.0;
+    float tempo = 90.0f;
+    int timeSigNumerator = 4;
+    int timeSigDenominator = 4;
+
+    juce::int64 samplePosition = 0;
+    juce::int64 tickPositionFixed = 0;
+    juce::int64 prevTickPositionFixed = 0;
+    juce::int64 ticksPerSampleFixed = 0;
+
+    void updateTicksPerSample()
+    {
+        double ticksPerSample = (tempo * ticksPerBeat) / (60.0 * sampleRate);
+        ticksPerSampleFixed = (juce::int64) std::llround(ticksPerSample * fractionOne);
+    }
+};
@@ -0,0 +1,77 @@
+/*
+  ==============================================================================
+
+    TripleBuffer.h
+    Created: 18 Oct 2026 10:31:48pm
+    Author:  User
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/*
+A lock-free triple buffer, for handing the latest value of something (e.g. a set of analysis
+results) from one thread to another when only the newest value matters.
+
+There are three copies: the writer fills in the 'back' one and publishes it, which swaps it with
+the 'middle' one. The reader swaps the 'front' one with the middle one whenever something new has
+been published. Neither side ever waits for the other, and the reader always gets a complete
+value (never one which is half written) - older values are simply skipped.
+
+One writer thread and one reader thread only.
+*/
+template <typename T>
+class TripleBuffer
+{
+public:
+
+    /*
+    The copy for the writer to fill in (writer thread only).
+    */
+    T& getWriteBuffer()
+    {
+        return buffers[backIndex];
+    }
+
+    /*
+    Make what's been written to getWriteBuffer() the latest value (writer thread only).
+    The writer then gets an older copy to write to, so it should fill in every field again.
+    */
+    void publish()
+    {
+        backIndex = middle.exchange(backIndex | newDataBit) & indexMask;
+    }
+
+    /*
+    The latest published value (reader thread only). The reference stays valid,
+    and unchanged, until the next call.
+    */
+    const T& read()
+    {
+        if (middle.load() & newDataBit)
+        {
+            frontIndex = middle.exchange(frontIndex) & indexMask;
+        }
+        return buffers[frontIndex];
+    }
+
+    /*
+    Whether anything has been published since the last read() (reader thread only).
+    */
+    bool hasNewData()
+    {
+        return (middle.load() & newDataBit) != 0;
+    }
+
+private:
+    static constexpr int indexMask = 3;
+    static constexpr int newDataBit = 4;
+
+    T buffers[3] = {};
+    int frontIndex = 0;        // <- reader's
+    std::atomic<int> middle { 1 };
+    int backIndex = 2;         // <- writer's
+};